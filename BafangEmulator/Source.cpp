@@ -1,10 +1,24 @@
 #include "trace.h"
 #include "serial_handler.h"
+#include "supervisor.h"
+#include "reactor.h"
+#include "listener.h"
 #include "exceptions.h"
+#include "persister.h"
 #include "profile.h"
 #include "getopt.h"
 
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <future>
+#include <memory>
+#include <unordered_map>
 #include <vector>
 
 
@@ -12,12 +26,23 @@ void usage()
 {
   printf("Usage: BafangEmulator -p PORT -g PATH -c PATH\r\n\r\n"
          "Bafang controller emulator, currently only supporting the configuration tool.\r\n\r\n"
-         "  -p, --port <ARG>    comms port to connect to, typically COM1...\n"
-         "      --port2 <ARG>   second comms port to connect to, typically COM1...\n"
-         "      --port3 <ARG>   third comms port to connect to, typically COM1...\n"
-         "      --port4 <ARG>   fourth comms port to connect to, typically COM1...\n"
+         "  -p, --port <ARG>    comms port to connect to, typically COM1... or /dev/ttyUSB0\n"
+         "      --port2 <ARG>   second comms port to connect to, typically COM1... or /dev/ttyUSB0\n"
+         "      --port3 <ARG>   third comms port to connect to, typically COM1... or /dev/ttyUSB0\n"
+         "      --port4 <ARG>   fourth comms port to connect to, typically COM1... or /dev/ttyUSB0\n"
          "  -g, --general <ARG> path for the general profile\n"
          "  -c, --config <ARG>  path of the config profile\n"
+         "  -e, --event-loop    service every port from a single epoll thread (Linux)\n"
+         "  -u, --io-uring      as --event-loop but with io_uring, batching reads across ports (Linux)\n"
+         "  -v, --virtual <N>   create N virtual controllers on pseudo-terminals (Linux)\n"
+         "      --virtual-list <ARG> file to write the virtual controller paths to\n"
+         "  -l, --listen <ARG>  accept clients on tcp://HOST:PORT or unix:///PATH, a session each (Linux)\n"
+         "      --time-scale <ARG> pace responses to the baud rate, 1.0 real time, 0.01 100x faster\n"
+         "  -r, --reconnect     re-open a port that disconnects, with exponential backoff\n"
+         "      --nak           answer unknown commands, unknown types and checksum failures with a NAK\n"
+         "      --status-mask   follow each write status with a mask of every failing field,\n"
+         "                      a full flash write with the basic, pedal and throttle masks\n"
+         "      --fsync <ARG>   flush saved profiles to disk: none, file (default) or full\n"
          "  -h, --help          display this help and exit\n"
          "  -V, --version       output version information and exit\r\n\r\n");
 }
@@ -33,8 +58,13 @@ int main(int argc, char* argv[])
   TRACE_FILENAME("BafangEmulator.txt");
   TRACE_MESSAGE("Application start");
 
-  std::vector<std::string> ports;
+  std::vector<std::string> ports, listens;
   std::string general, config;
+  std::string virtual_list;
+  bool event_loop = false, io_uring = false, reconnect = false, nak = false, status_mask = false;
+  int virtual_count = 0;
+  double time_scale = 0.0;
+  core::persister::sync_policy sync = core::persister::sync_policy::file;
   option long_options[] =
   {
     { "port",      required_argument, 0, 'p' },
@@ -43,6 +73,16 @@ int main(int argc, char* argv[])
     { "port4",     required_argument, 0,  4  },
     { "general",   required_argument, 0, 'g' },
     { "config",    required_argument, 0, 'c' },
+    { "event-loop", no_argument,      0, 'e' },
+    { "virtual",   required_argument, 0, 'v' },
+    { "virtual-list", required_argument, 0, 5 },
+    { "listen",    required_argument, 0, 'l' },
+    { "io-uring",  no_argument,       0, 'u' },
+    { "time-scale", required_argument, 0, 6 },
+    { "reconnect", no_argument,       0, 'r' },
+    { "nak",       no_argument,       0,  7  },
+    { "status-mask", no_argument,     0,  8  },
+    { "fsync",     required_argument, 0,  9  },
     { "help",      no_argument,       0, 'h' },
     { "version",   no_argument,       0, 'V' },
     { 0, 0, 0, 0 },
@@ -50,7 +90,7 @@ int main(int argc, char* argv[])
 
   /* Handle the arguments */
   int c = 0, option_index = 0;
-  while ((c = getopt_long(argc, argv, "p:g:c:hV", long_options, &option_index)) >= 0)
+  while ((c = getopt_long(argc, argv, "p:g:c:euv:l:rhV", long_options, &option_index)) >= 0)
   {
     switch (c)
     {
@@ -60,6 +100,49 @@ int main(int argc, char* argv[])
     case  4 :  ports.push_back(optarg); break;
     case 'g':  general = optarg; break;
     case 'c':  config  = optarg; break;
+    case 'e':  event_loop = true; break;
+    case 'u':  event_loop = io_uring = true; break;
+    case 'v':
+      {
+        char* end = nullptr;
+        long count = strtol(optarg, &end, 10);
+        if (end == optarg || *end != '\0' || count <= 0 || count > INT_MAX)
+        {
+          usage();
+          return 1;
+        }
+        virtual_count = static_cast<int>(count);
+      }
+      break;
+    case  5 :  virtual_list = optarg; break;
+    case 'l':  listens.push_back(optarg); break;
+    case  6 :
+      {
+        char* end = nullptr;
+        time_scale = strtod(optarg, &end);
+        if (end == optarg || *end != '\0' || !std::isfinite(time_scale) || time_scale < 0.0)
+        {
+          usage();
+          return 1;
+        }
+      }
+      break;
+    case 'r':  reconnect = true; break;
+    case  7 :  nak = true; break;
+    case  8 :  status_mask = true; break;
+    case  9 :
+      if (strcmp(optarg, "none") == 0)
+        sync = core::persister::sync_policy::none;
+      else if (strcmp(optarg, "file") == 0)
+        sync = core::persister::sync_policy::file;
+      else if (strcmp(optarg, "full") == 0)
+        sync = core::persister::sync_policy::full;
+      else
+      {
+        usage();
+        return 1;
+      }
+      break;
     case 'V':  version();        return 0;
     case 'h':
     case '\0':
@@ -68,37 +151,212 @@ int main(int argc, char* argv[])
     }
   }
 
-  if (!ports.empty() && !general.empty() && !config.empty())
+  // Each virtual controller is a pseudo-terminal created on connect
+  for (int i = 0; i < virtual_count; i++)
+  {
+    ports.push_back("pty://");
+  }
+
+  if ((!ports.empty() || !listens.empty()) && !general.empty() && !config.empty())
   {
     try
     {
+      // Saves are written behind the serial threads, and flushed when the persister goes
+      core::persister persist(sync);
       core::profile g(general);
       core::profile c(config);
-      std::vector<std::future<void>> workers;
+      g.persist(&persist);
+      c.persist(&persist);
+      std::vector<std::unique_ptr<core::serial_handler>> handlers;
+      std::vector<std::unique_ptr<core::supervisor>> supervisors;
+      std::vector<std::unique_ptr<core::listener>> listeners;
 
-      // Establish workers for each serial port
+      // Open every serial port, one failing port does not stop the others,
+      // with -r a supervisor keeps retrying it
       for (const auto& port : ports)
       {
-        auto f = std::async([&](std::string prt)
+        try
         {
-          try
+          handlers.emplace_back(new core::serial_handler(port, g, c, !reconnect));
+          handlers.back()->time_scale(time_scale);
+          handlers.back()->nak(nak);
+          handlers.back()->status_mask(status_mask);
+          if (reconnect)
           {
-            core::serial_handler s(prt, g, c);
-            s.poll();
+            supervisors.emplace_back(new core::supervisor(*handlers.back()));
+            supervisors.back()->open();
           }
-          catch (...)
+        }
+        catch (...)
+        {
+          core::exception_handler();
+        }
+      }
+
+      // Open every listening endpoint
+      for (const auto& address : listens)
+      {
+        try
+        {
+          listeners.emplace_back(new core::listener(address));
+        }
+        catch (...)
+        {
+          core::exception_handler();
+        }
+      }
+
+      // Publish where clients can reach the virtual controllers
+      if (virtual_count > 0)
+      {
+        FILE* list = virtual_list.empty() ? nullptr : fopen(virtual_list.c_str(), "w");
+        if (!virtual_list.empty() && !list)
+          TRACE_MESSAGE("virtual list \"%s\" open failure: %s", virtual_list.c_str(), strerror(errno));
+        for (const auto& handler : handlers)
+        {
+          printf("%s\n", handler->port().c_str());
+          if (list)
+            fprintf(list, "%s\n", handler->port().c_str());
+        }
+        fflush(stdout);
+        if (list)
+          fclose(list);
+      }
+
+      if (event_loop)
+      {
+        core::reactor r(io_uring ? core::reactor::backends::io_uring : core::reactor::backends::epoll);
+        std::unordered_map<core::serial_handler*, std::unique_ptr<core::serial_handler>> sessions;
+
+        // Attach every serial port to the one event loop
+        if (reconnect)
+        {
+          for (const auto& supervisor : supervisors)
+          {
+            supervisor->attach(r);
+          }
+        }
+        else
+        {
+          for (const auto& handler : handlers)
           {
-            core::exception_handler();
+            handler->attach(r);
           }
-        }, port);
+        }
 
-        workers.push_back(std::move(f));
-      }
+        // Each accepted client becomes a session, released when it disconnects
+        for (const auto& l : listeners)
+        {
+          r.add(l->native_handle(), core::bind([&, listen = l.get()]()
+          {
+            core::serial s;
+            while (listen->accept(s))
+            {
+              std::unique_ptr<core::serial_handler> session(new core::serial_handler(std::move(s), g, c));
+              core::serial_handler* key = session.get();
+              session->time_scale(time_scale);
+              session->nak(nak);
+              session->status_mask(status_mask);
+
+              session->attach(r, core::bind([&sessions, key]() { sessions.erase(key); }));
+              sessions[key] = std::move(session);
+              s = core::serial();
+            }
+
+            // Out of descriptors the listening socket stays readable, stop watching it while accept backs off
+            if (listen->resume() > core::listener::clock::now())
+              r.pause(listen->native_handle(), listen->resume());
+          }));
+        }
 
-      // Wait for workers to complete
-      for (const auto& worker : workers)
+        r.run();
+      }
+      else
       {
-        worker.wait();
+        std::vector<std::future<void>> workers;
+
+        // Establish workers for each serial port
+        for (size_t i = 0; i < handlers.size(); i++)
+        {
+          core::serial_handler* handler = handlers[i].get();
+          core::supervisor* supervisor = reconnect ? supervisors[i].get() : nullptr;
+          auto f = std::async([handler, supervisor]()
+          {
+            try
+            {
+              if (supervisor)
+                supervisor->run();
+              else
+                handler->poll();
+            }
+            catch (...)
+            {
+              core::exception_handler();
+            }
+          });
+
+          workers.push_back(std::move(f));
+        }
+
+        // Accept clients on each endpoint, every session getting its own thread
+        for (const auto& l : listeners)
+        {
+          auto f = std::async([&g, &c, time_scale, nak, status_mask, listen = l.get()]()
+          {
+            // The worker owns its sessions and joins them before it returns,
+            // so none outlives the profiles it serves
+            std::vector<std::future<void>> sessions;
+
+            try
+            {
+              while (listen->wait())
+              {
+                // Forget the sessions whose clients have gone
+                sessions.erase(std::remove_if(sessions.begin(), sessions.end(), [](const std::future<void>& session)
+                {
+                  return session.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+                }), sessions.end());
+
+                core::serial s;
+                if (!listen->accept(s))
+                  continue;
+
+                sessions.push_back(std::async(std::launch::async, [&g, &c, time_scale, nak, status_mask](core::serial s)
+                {
+                  try
+                  {
+                    core::serial_handler session(std::move(s), g, c);
+                    session.time_scale(time_scale);
+                    session.nak(nak);
+                    session.status_mask(status_mask);
+                    session.poll();
+                  }
+                  catch (...)
+                  {
+                    core::exception_handler();
+                  }
+                }, std::move(s)));
+              }
+            }
+            catch (...)
+            {
+              core::exception_handler();
+            }
+
+            for (const auto& session : sessions)
+            {
+              session.wait();
+            }
+          });
+
+          workers.push_back(std::move(f));
+        }
+
+        // Wait for workers to complete
+        for (const auto& worker : workers)
+        {
+          worker.wait();
+        }
       }
     }
     catch (...)
@@ -0,0 +1,194 @@
+#include "batch_validator.h"
+#include "packet_builder.h"
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+
+namespace core
+{
+  namespace batch_validator
+  {
+    namespace
+    {
+      // Requests per pass over the fields, the status codes stay in L1
+      const size_t chunk_size = 1024;
+
+      // Below this a batch is not worth a thread
+      const size_t thread_batch = 64 * 1024;
+
+      /**
+       * @brief Applies one field's range check to a chunk, the first failure of a request is kept
+       *
+       * Written with & rather than && and a single subtract-compare for the range,
+       * so the loop has no control flow, and always runs a whole chunk, so its
+       * trip count is fixed. Both are needed for the loop to vectorize at -O2.
+       */
+      void check_range(const uint8_t (&column)[chunk_size], uint8_t (&codes)[chunk_size], uint8_t success, uint8_t code, int min, int max, int also)
+      {
+        const uint8_t low = static_cast<uint8_t>(min);
+        const uint8_t span = static_cast<uint8_t>(max - min);
+        const uint8_t other = static_cast<uint8_t>(also < 0 ? min : also); // min is never out of range, so "no also" costs nothing
+
+        for (size_t i = 0; i < chunk_size; i++)
+        {
+          uint8_t v = column[i];
+          bool bad = (static_cast<uint8_t>(v - low) > span) & (v != other);
+          codes[i] = ((codes[i] == success) & bad) ? code : codes[i];
+        }
+      }
+
+      // Wheel sizes are the even values 32 to 60, plus 55 for 27.5". Odd is tested
+      // with shifts, as g++ will not vectorize a bool taken from v & 1.
+      constexpr bool bad_wheel_size(uint8_t v)
+      {
+        return ((static_cast<uint8_t>(v - 32) > 28) | (static_cast<uint8_t>((v >> 1) << 1) != v)) & (v != 55);
+      }
+
+      constexpr bool wheel_sizes_match()
+      {
+        for (int v = 0; v < 256; v++)
+        {
+          if (bad_wheel_size(static_cast<uint8_t>(v)) == packet_builder::valid_wheel_size(static_cast<uint8_t>(v)))
+            return false;
+        }
+        return true;
+      }
+
+      static_assert(wheel_sizes_match(), "wheel size check matches packet_builder::wheels");
+
+      void check_wheel_size(const uint8_t (&column)[chunk_size], uint8_t (&codes)[chunk_size], uint8_t success, uint8_t code)
+      {
+        for (size_t i = 0; i < chunk_size; i++)
+        {
+          bool bad = bad_wheel_size(column[i]);
+          codes[i] = ((codes[i] == success) & bad) ? code : codes[i];
+        }
+      }
+
+      // Model 0 to 2 in the top two bits, 1 to 36 signals in the rest
+      constexpr bool bad_speed_meter(uint8_t v)
+      {
+        return (v >= 192) | ((v & 63) > 36) | ((v & 63) == 0);
+      }
+
+      constexpr bool speed_meters_match()
+      {
+        for (int v = 0; v < 256; v++)
+        {
+          if (bad_speed_meter(static_cast<uint8_t>(v)) == packet_builder::valid_speed_meter(static_cast<uint8_t>(v)))
+            return false;
+        }
+        return true;
+      }
+
+      static_assert(speed_meters_match(), "speed meter check matches packet_builder::valid_speed_meter");
+
+      void check_speed_meter(const uint8_t (&column)[chunk_size], uint8_t (&codes)[chunk_size], uint8_t success, uint8_t code)
+      {
+        for (size_t i = 0; i < chunk_size; i++)
+        {
+          bool bad = bad_speed_meter(column[i]);
+          codes[i] = ((codes[i] == success) & bad) ? code : codes[i];
+        }
+      }
+
+      template<class T, class Status>
+      void run(void (*chunk)(const T*, size_t, Status*), const T* requests, size_t count, Status* results, unsigned threads)
+      {
+        if (threads == 0)
+          threads = std::max(1u, std::thread::hardware_concurrency());
+        threads = static_cast<unsigned>(std::min<size_t>(threads, (count + thread_batch - 1) / thread_batch));
+
+        auto slice = [&](size_t begin, size_t end)
+        {
+          for (size_t i = begin; i < end; i += chunk_size)
+            chunk(requests + i, std::min(chunk_size, end - i), results + i);
+        };
+
+        if (threads <= 1)
+        {
+          slice(0, count);
+          return;
+        }
+
+        // Slices are whole chunks, so no two threads write the same cache line of results
+        size_t per_thread = (count / threads + chunk_size - 1) / chunk_size * chunk_size;
+        std::vector<std::thread> workers;
+        for (unsigned t = 1; t < threads && t * per_thread < count; t++)
+          workers.emplace_back(slice, t * per_thread, std::min(count, (t + 1) * per_thread));
+
+        slice(0, std::min(count, per_thread));
+        for (auto& worker : workers)
+          worker.join();
+      }
+    }
+
+// Each field is copied out of the packed requests into a contiguous column,
+// then checked a column at a time. The checks run over the whole chunk, the
+// codes past count are never read. Fields are checked in schema order and
+// the first failure wins, as in packet_builder::parse().
+#define BATCH_FIELD(name, code, key, value, min, max, also) \
+      for (size_t i = 0; i < count; i++) \
+        column[i] = requests[i].name; \
+      check_range(column, codes, success, code, min, max, also);
+#define BATCH_CUSTOM(name, code) \
+      for (size_t i = 0; i < count; i++) \
+        column[i] = requests[i].name; \
+      check_##name(column, codes, success, code);
+
+    namespace
+    {
+      void validate_chunk(const request_basic* requests, size_t count, response_status_basic* results)
+      {
+        const uint8_t success = static_cast<uint8_t>(response_status_basic::success);
+        uint8_t codes[chunk_size], column[chunk_size] = {};
+        std::fill(std::begin(codes), std::end(codes), success);
+
+        PACKET_BASIC_SCHEMA(BATCH_FIELD, BATCH_CUSTOM)
+
+        for (size_t i = 0; i < count; i++)
+          results[i] = static_cast<response_status_basic>(codes[i]);
+      }
+
+      void validate_chunk(const request_pedal* requests, size_t count, response_status_pedal* results)
+      {
+        const uint8_t success = static_cast<uint8_t>(response_status_pedal::success);
+        uint8_t codes[chunk_size], column[chunk_size] = {};
+        std::fill(std::begin(codes), std::end(codes), success);
+
+        PACKET_PEDAL_SCHEMA(BATCH_FIELD, BATCH_CUSTOM)
+
+        for (size_t i = 0; i < count; i++)
+          results[i] = static_cast<response_status_pedal>(codes[i]);
+      }
+
+      void validate_chunk(const request_throttle* requests, size_t count, response_status_throttle* results)
+      {
+        const uint8_t success = static_cast<uint8_t>(response_status_throttle::success);
+        uint8_t codes[chunk_size], column[chunk_size] = {};
+        std::fill(std::begin(codes), std::end(codes), success);
+
+        PACKET_THROTTLE_SCHEMA(BATCH_FIELD, BATCH_CUSTOM)
+
+        for (size_t i = 0; i < count; i++)
+          results[i] = static_cast<response_status_throttle>(codes[i]);
+      }
+    }
+
+    void validate(const request_basic* requests, size_t count, response_status_basic* results, unsigned threads)
+    {
+      run<request_basic, response_status_basic>(&validate_chunk, requests, count, results, threads);
+    }
+
+    void validate(const request_pedal* requests, size_t count, response_status_pedal* results, unsigned threads)
+    {
+      run<request_pedal, response_status_pedal>(&validate_chunk, requests, count, results, threads);
+    }
+
+    void validate(const request_throttle* requests, size_t count, response_status_throttle* results, unsigned threads)
+    {
+      run<request_throttle, response_status_throttle>(&validate_chunk, requests, count, results, threads);
+    }
+  }
+}
@@ -0,0 +1,53 @@
+#include "gtest/gtest.h"
+#include "batch_validator.h"
+#include "packet_builder.h"
+#include <random>
+#include <vector>
+
+
+namespace
+{
+  template<class T>
+  std::vector<T> random_requests(size_t count)
+  {
+    std::mt19937 rng(42);
+    std::vector<T> requests(count);
+    uint8_t* data = reinterpret_cast<uint8_t*>(requests.data());
+    for (size_t i = 0; i < count * sizeof(T); i++)
+    {
+      // Mostly in range, so later fields get checked too
+      data[i] = static_cast<uint8_t>(rng() % 16 == 0 ? rng() : rng() % 40 + 1);
+    }
+    return requests;
+  }
+
+  template<class T, class Status>
+  void expect_same_as_apply(size_t count, unsigned threads)
+  {
+    std::vector<T> requests = random_requests<T>(count);
+    std::vector<Status> results(count);
+    core::batch_validator::validate(requests.data(), count, results.data(), threads);
+
+    core::profile temp;
+    for (size_t i = 0; i < count; i++)
+    {
+      ASSERT_EQ(results[i], core::packet_builder::apply(requests[i], temp)) << "request " << i;
+    }
+  }
+}
+
+TEST(batch_validator, basic_test)
+{
+  expect_same_as_apply<core::request_basic, core::response_status_basic>(5000, 1);
+}
+
+TEST(batch_validator, pedal_test)
+{
+  expect_same_as_apply<core::request_pedal, core::response_status_pedal>(5000, 1);
+}
+
+TEST(batch_validator, throttle_threads_test)
+{
+  // Uneven slices across threads, with a partial last chunk
+  expect_same_as_apply<core::request_throttle, core::response_status_throttle>(200003, 3);
+}
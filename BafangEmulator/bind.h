@@ -6,15 +6,16 @@
 
 namespace core
 {
+  template<class... Args>
   struct bind_base
   {
     virtual ~bind_base() {}
-    virtual void invoke() = 0;
+    virtual void invoke(Args... args) = 0;
   };
 
 
-  template<class Func>
-  struct bind_impl : bind_base
+  template<class Func, class... Args>
+  struct bind_impl : bind_base<Args...>
   {
     bind_impl(Func&& func)
       : func_(std::forward<Func>(func))
@@ -23,9 +24,9 @@ namespace core
     virtual ~bind_impl()
     {}
 
-    virtual void invoke()
+    virtual void invoke(Args... args)
     {
-      func_();
+      func_(args...);
     }
 
   protected:
@@ -34,10 +35,10 @@ namespace core
   };
 
 
-  template<class Obj>
-  struct bind_member_impl : bind_base
+  template<class Obj, class... Args>
+  struct bind_member_impl : bind_base<Args...>
   {
-    typedef void(Obj::*Func)();
+    typedef void(Obj::*Func)(Args...);
 
     bind_member_impl(Func func, Obj* obj)
       : func_(func)
@@ -47,9 +48,9 @@ namespace core
     virtual ~bind_member_impl()
     {}
 
-    virtual void invoke()
+    virtual void invoke(Args... args)
     {
-      (obj_->*func_)();
+      (obj_->*func_)(args...);
     }
 
   protected:
@@ -59,36 +60,37 @@ namespace core
   };
 
 
-  class bind
+  template<class... Args>
+  class basic_bind
   {
   public:
 
     template<class Func>
-    explicit bind(Func&& func)
-      : impl_(new bind_impl<Func>(std::forward<Func>(func)))
+    explicit basic_bind(Func&& func)
+      : impl_(new bind_impl<Func, Args...>(std::forward<Func>(func)))
     {}
 
     template<class Obj>
-    explicit bind(void(Obj::*func)(), Obj* obj)
-      : impl_(new bind_member_impl<Obj>(func, obj))
+    explicit basic_bind(void(Obj::*func)(Args...), Obj* obj)
+      : impl_(new bind_member_impl<Obj, Args...>(func, obj))
     {}
 
-    bind() = default;
-    bind(bind&&) = default;
-    bind(const bind&) = delete;
-    bind& operator=(bind&&) = default;
-    bind& operator=(const bind&) = delete;
-    ~bind() = default;
+    basic_bind() = default;
+    basic_bind(basic_bind&&) = default;
+    basic_bind(const basic_bind&) = delete;
+    basic_bind& operator=(basic_bind&&) = default;
+    basic_bind& operator=(const basic_bind&) = delete;
+    ~basic_bind() = default;
 
     operator bool() const
     {
       return impl_ != nullptr;
     }
 
-    void operator()()
+    void operator()(Args... args)
     {
       if (impl_)
-        impl_->invoke();
+        impl_->invoke(args...);
       else
         throw std::runtime_error("no state");
     }
@@ -96,6 +98,9 @@ namespace core
 
   protected:
 
-    std::unique_ptr<bind_base> impl_;
+    std::unique_ptr<bind_base<Args...>> impl_;
   };
+
+
+  using bind = basic_bind<>;
 }
@@ -0,0 +1,173 @@
+#include "dispatcher.h"
+#include "packet.h"
+#include "packet_builder.h"
+#include "trace.h"
+#include <stdexcept>
+
+
+namespace core
+{
+  namespace
+  {
+    /**
+     * @brief The serialized response of a read, only rebuilt when the profile changes
+     *
+     * Handlers run under serial_handler's profile lock, which also guards the cache.
+     */
+    template<class T>
+    std::string_view cached_read(profile& p)
+    {
+      static uint64_t version = 0; // Never a profile version
+      static std::array<char, response_packet<T>::packet_size()> bytes;
+
+      if (version != p.version())
+      {
+        response_packet<T> response;
+        packet_builder::build(response, p);
+        response.serialize(bytes);
+
+        // Building may have added the defaults to a new profile, which is a new version
+        version = p.version();
+      }
+
+      return std::string_view(bytes.data(), bytes.size());
+    }
+
+    size_t copy(std::string_view response, dispatcher::response_buffer& out, size_t offset = 0)
+    {
+      return offset + response.copy(out.data() + offset, response.size());
+    }
+
+    size_t read_general(std::string_view /*request*/, dispatcher::response_buffer& out, profile& general, profile& /*config*/)
+    {
+      return copy(cached_read<response_general>(general), out);
+    }
+
+    template<class T>
+    size_t read_block(std::string_view /*request*/, dispatcher::response_buffer& out, profile& /*general*/, profile& config)
+    {
+      return copy(cached_read<T>(config), out);
+    }
+
+    template<class T, class Status>
+    size_t write_block(std::string_view request, dispatcher::response_buffer& out, profile& /*general*/, profile& config)
+    {
+      packet_view<T> packet(request, verified_frame);
+
+      Status result = packet_builder::parse(packet.payload(), config);
+      if (result != Status::success)
+        TRACE_MESSAGE("write 0x%X rejected, failures 0x%08X", static_cast<int>(T::packet_type), packet_builder::validate(packet.payload()));
+
+      response_status_packet<Status> response(T::packet_type, result);
+      return response.serialize(out);
+    }
+
+    size_t append_mask(uint32_t failures, dispatcher::response_buffer& out, size_t length)
+    {
+      for (int i = 0; i < 4; i++)
+      {
+        out[length++] = static_cast<char>(failures >> (8 * i));
+      }
+      return length;
+    }
+
+    // Each status response is the type then the status, the mask is only worked out for a failure
+    template<class T, class Status>
+    size_t append_block_mask(const T& request, const char* status, dispatcher::response_buffer& out, size_t length)
+    {
+      bool success = static_cast<uint8_t>(status[1]) == static_cast<uint8_t>(Status::success);
+      return append_mask(success ? 0 : packet_builder::validate(request), out, length);
+    }
+
+    template<class T, class Status>
+    size_t validate_block(std::string_view request, dispatcher::response_buffer& out, size_t length)
+    {
+      packet_view<T> packet(request, verified_frame);
+      return append_block_mask<T, Status>(packet.payload(), out.data(), out, length);
+    }
+
+    size_t read_all(std::string_view /*request*/, dispatcher::response_buffer& out, profile& general, profile& config)
+    {
+      // The same responses as the single block reads, back-to-back
+      size_t length = copy(cached_read<response_general>(general), out);
+      length = copy(cached_read<response_basic>(config), out, length);
+      length = copy(cached_read<response_pedal>(config), out, length);
+      return copy(cached_read<response_throttle>(config), out, length);
+    }
+
+    size_t write_all(std::string_view request, dispatcher::response_buffer& out, profile& /*general*/, profile& config)
+    {
+      packet_view<request_all> packet(request, verified_frame);
+
+      response_status_all result = packet_builder::parse(packet.payload(), config);
+      if (!result.success())
+        TRACE_MESSAGE("write all rejected, failures basic 0x%08X, pedal 0x%08X, throttle 0x%08X",
+                      packet_builder::validate(packet->basic), packet_builder::validate(packet->pedal), packet_builder::validate(packet->throttle));
+
+      size_t length = response_status_packet<response_status_basic>(packet_types::basic, result.basic).serialize(out);
+      length = response_status_packet<response_status_pedal>(packet_types::pedal, result.pedal).serialize(out, length);
+      return response_status_packet<response_status_throttle>(packet_types::throttle, result.throttle).serialize(out, length);
+    }
+
+    // The basic, pedal and throttle masks follow the three status responses
+    size_t validate_all(std::string_view request, dispatcher::response_buffer& out, size_t length)
+    {
+      packet_view<request_all> packet(request, verified_frame);
+      const size_t status_size = response_status_packet<response_status_basic>::packet_size();
+      length = append_block_mask<request_basic, response_status_basic>(packet->basic, out.data(), out, length);
+      length = append_block_mask<request_pedal, response_status_pedal>(packet->pedal, out.data() + status_size, out, length);
+      return append_block_mask<request_throttle, response_status_throttle>(packet->throttle, out.data() + 2 * status_size, out, length);
+    }
+
+    template<class T>
+    void add_read(dispatcher& d, const char* name)
+    {
+      // Configuration reads are just the command and type
+      d.add(packet_commands::read, T::packet_type, 2, &read_block<T>, name);
+    }
+
+    template<class T, class Status>
+    void add_write(dispatcher& d, const char* name)
+    {
+      d.add(packet_commands::write, T::packet_type, request_packet<T>::packet_size(), &write_block<T, Status>, name, &validate_block<T, Status>);
+    }
+  }
+
+
+  dispatcher::dispatcher()
+    : table_()
+  {}
+
+
+  dispatcher& dispatcher::instance()
+  {
+    static dispatcher d = []()
+    {
+      dispatcher d;
+      d.add(packet_commands::read, packet_types::general, request_packet<request_general>::packet_size(), &read_general, "read general");
+      add_read<response_basic>(d, "read basic");
+      add_read<response_pedal>(d, "read pedal assist");
+      add_read<response_throttle>(d, "read throttle handle");
+      add_write<request_basic, response_status_basic>(d, "write basic");
+      add_write<request_pedal, response_status_pedal>(d, "write pedal assist");
+      add_write<request_throttle, response_status_throttle>(d, "write throttle handle");
+      d.add(packet_commands::read, packet_types::all, 2, &read_all, "read all");
+      d.add(packet_commands::write, packet_types::all, request_packet<request_all>::packet_size(), &write_all, "write all", &validate_all);
+      return d;
+    }();
+
+    return d;
+  }
+
+
+  void dispatcher::add(packet_commands command, packet_types type, size_t length, handler func, const char* name, validator validate)
+  {
+    size_t i = index(command, type);
+    if (i >= table_.size())
+      throw std::runtime_error("unsupported command");
+    if (length < 2 || !func)
+      throw std::runtime_error("invalid handler");
+
+    table_[i] = { length, func, name, validate };
+  }
+}
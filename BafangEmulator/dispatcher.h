@@ -0,0 +1,97 @@
+#pragma once
+#include "packet_types.h"
+#include "profile.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+
+namespace core
+{
+  /**
+   * @brief Request handlers keyed by (command, type)
+   *
+   * Every packet block is registered with its request length and the handler
+   * that turns a request frame into the response, so the frame parser and
+   * serial_handler never need to know the individual blocks. Lookup is a
+   * single table index. Register new blocks before any port is serviced.
+   */
+  class dispatcher
+  {
+  public:
+
+    /**
+     * @brief The response is serialized into a fixed buffer, so answering allocates nothing
+     */
+    using response_buffer = std::array<char, 256>;
+
+    /**
+     * @brief Handles one whole request frame, returns the length of the response written
+     *
+     * The frame is one the frame_parser yielded, its checksum is not checked again.
+     */
+    using handler = size_t (*)(std::string_view request, response_buffer& response, profile& general, profile& config);
+
+    /**
+     * @brief Appends the failure masks of a write after its status response
+     *
+     * Each mask is 32 bits little-endian, a bit per failing status code, and is
+     * only computed when its status is not success. Returns the new response length.
+     */
+    using validator = size_t (*)(std::string_view request, response_buffer& response, size_t length);
+
+    struct entry
+    {
+      size_t length;    // Request frame length, 0 when nothing is registered
+      handler func;
+      const char* name;
+      validator validate; // Writes only, otherwise nullptr
+    };
+
+    dispatcher();
+   ~dispatcher() = default;
+
+    /**
+     * @brief The dispatcher with every packet block registered
+     */
+    static dispatcher& instance();
+
+    /**
+     * @brief Register the handler of a request
+     *
+     * @param[in] command The request command
+     * @param[in] type The packet block
+     * @param[in] length The length of the request frame including the header
+     * @param[in] func The handler
+     * @param[in] name Name of the request for tracing
+     * @param[in] validate Appends every failing field of a write request to its response
+     */
+    void add(packet_commands command, packet_types type, size_t length, handler func, const char* name, validator validate = nullptr);
+
+    /**
+     * @brief Look up the handler of a request
+     *
+     * @return The entry, or nullptr when the request is not supported
+     */
+    const entry* find(packet_commands command, packet_types type) const
+    {
+      size_t i = index(command, type);
+      return (i < table_.size() && table_[i].length) ? &table_[i] : nullptr;
+    }
+
+  private:
+
+    static size_t index(packet_commands command, packet_types type)
+    {
+      switch (command)
+      {
+        case packet_commands::read:  return static_cast<uint8_t>(type);
+        case packet_commands::write: return 256 + static_cast<uint8_t>(type);
+      }
+      return static_cast<size_t>(-1);
+    }
+
+    std::array<entry, 512> table_;
+  };
+}
@@ -0,0 +1,111 @@
+#include "gtest/gtest.h"
+#include "dispatcher.h"
+#include "frame_parser.h"
+#include "packet.h"
+#include "packet_all.h"
+#include <cstdio>
+#include <cstring>
+
+
+namespace
+{
+  size_t echo(std::string_view request, core::dispatcher::response_buffer& response, core::profile& /*general*/, core::profile& /*config*/)
+  {
+    return request.copy(response.data(), request.size());
+  }
+}
+
+TEST(dispatcher, default_test)
+{
+  const core::dispatcher& d = core::dispatcher::instance();
+
+  ASSERT_NE(d.find(core::packet_commands::read, core::packet_types::general), nullptr);
+  EXPECT_EQ(d.find(core::packet_commands::read, core::packet_types::general)->length, 5);
+  EXPECT_EQ(d.find(core::packet_commands::read, core::packet_types::basic)->length, 2);
+  EXPECT_EQ(d.find(core::packet_commands::write, core::packet_types::throttle)->length, 10);
+  EXPECT_EQ(d.find(core::packet_commands::write, core::packet_types::general), nullptr);
+}
+
+TEST(dispatcher, register_test)
+{
+  core::dispatcher d;
+  core::frame_parser parser(d);
+  std::string request = { 0x11, 0x55 };
+  size_t length = 0;
+
+  EXPECT_EQ(parser.parse(request, length), core::frame_parser::results::garbage);
+
+  d.add(core::packet_commands::read, static_cast<core::packet_types>(0x55), 2, &echo, "read echo");
+  EXPECT_EQ(parser.parse(request, length), core::frame_parser::results::frame);
+  EXPECT_EQ(length, 2);
+
+  core::profile general, config;
+  core::dispatcher::response_buffer response;
+  size_t written = d.find(core::packet_commands::read, static_cast<core::packet_types>(0x55))->func(request, response, general, config);
+  EXPECT_EQ(std::string(response.data(), written), request);
+}
+
+TEST(dispatcher, full_flash_test)
+{
+  std::remove("dispatcher_test.el");
+  core::profile general("dispatcher_test.el"), config("dispatcher_test.el");
+  const core::dispatcher& d = core::dispatcher::instance();
+  core::dispatcher::response_buffer response;
+
+  // Read all answers with every block back-to-back
+  std::string read = { 0x11, 0x50 };
+  size_t length = d.find(core::packet_commands::read, core::packet_types::all)->func(read, response, general, config);
+  ASSERT_EQ(length, 18 + 26 + 13 + 8);
+  EXPECT_EQ(response[0], 0x51);
+  EXPECT_EQ(response[18], 0x52);
+  EXPECT_EQ(response[18 + 26], 0x53);
+  EXPECT_EQ(response[18 + 26 + 13], 0x54);
+
+  // Write all stores nothing unless every block is valid
+  core::request_packet<core::request_all> write(core::packet_commands::write, core::packet_types::all);
+  memcpy(&write.payload.basic, response.data() + 18 + 2, sizeof(write.payload.basic));
+  memcpy(&write.payload.pedal, response.data() + 18 + 26 + 2, sizeof(write.payload.pedal));
+  memcpy(&write.payload.throttle, response.data() + 18 + 26 + 13 + 2, sizeof(write.payload.throttle));
+  write.payload.basic.current_limit = 30;
+  write.payload.throttle.mode = 2;
+  write.verification = write.verify();
+
+  length = d.find(core::packet_commands::write, core::packet_types::all)->func(write.serialize(), response, general, config);
+  ASSERT_EQ(length, 6);
+  EXPECT_EQ(response[1], static_cast<char>(core::response_status_basic::success));
+  EXPECT_EQ(response[5], static_cast<char>(core::response_status_throttle::mode));
+  EXPECT_EQ(config.find("Basic", "LC", 25), 25);
+
+  // The masks follow the three statuses, only the throttle block failed
+  length = d.find(core::packet_commands::write, core::packet_types::all)->validate(write.serialize(), response, length);
+  ASSERT_EQ(length, 6 + 3 * 4);
+  EXPECT_EQ(std::string(response.data() + 6, 12), std::string("\0\0\0\0\0\0\0\0\x04\0\0\0", 12));
+
+  write.payload.throttle.mode = 1;
+  write.verification = write.verify();
+  d.find(core::packet_commands::write, core::packet_types::all)->func(write.serialize(), response, general, config);
+  EXPECT_EQ(config.find("Basic", "LC", 25), 30);
+  EXPECT_EQ(config.find("Throttle Handle", "MODE", 0), 1);
+}
+
+TEST(dispatcher, cached_read_test)
+{
+  std::remove("dispatcher_test.el");
+  core::profile general("dispatcher_test.el"), config("dispatcher_test.el");
+  const core::dispatcher& d = core::dispatcher::instance();
+  core::dispatcher::response_buffer response;
+
+  std::string read = { 0x11, 0x52 };
+  d.find(core::packet_commands::read, core::packet_types::basic)->func(read, response, general, config);
+  EXPECT_EQ(response[3], 25);
+
+  // A successful write is seen by the next read
+  core::request_packet<core::request_basic> write(core::packet_commands::write, core::packet_types::basic);
+  memcpy(&write.payload, response.data() + 2, sizeof(write.payload));
+  write.payload.current_limit = 18;
+  write.verification = write.verify();
+  d.find(core::packet_commands::write, core::packet_types::basic)->func(write.serialize(), response, general, config);
+
+  d.find(core::packet_commands::read, core::packet_types::basic)->func(read, response, general, config);
+  EXPECT_EQ(response[3], 18);
+}
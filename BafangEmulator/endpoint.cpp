@@ -0,0 +1,216 @@
+#include "endpoint.h"
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+
+#if !defined (_WIN32)
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+
+namespace core
+{
+  endpoint endpoint::parse(const std::string& address)
+  {
+    endpoint ep;
+    ep.kind = kinds::device;
+    ep.path = address;
+
+    if (address.compare(0, 6, "pty://") == 0)
+    {
+      ep.kind = kinds::pty;
+      ep.path.clear();
+    }
+    else if (address.compare(0, 7, "unix://") == 0)
+    {
+      ep.kind = kinds::unix_socket;
+      ep.path = address.substr(7);
+
+      if (ep.path.empty())
+        throw std::invalid_argument("endpoint missing path (" + address + ")");
+    }
+    else if (address.compare(0, 6, "tcp://") == 0)
+    {
+      ep.kind = kinds::tcp;
+      ep.path.clear();
+
+      std::string rest = address.substr(6);
+      auto colon = rest.rfind(':');
+      if (colon == std::string::npos || colon + 1 == rest.length())
+        throw std::invalid_argument("endpoint missing port (" + address + ")");
+
+      ep.host = rest.substr(0, colon);
+      ep.service = rest.substr(colon + 1);
+
+      // Allow [::1]:port for IPv6 literals
+      if (ep.host.length() >= 2 && ep.host.front() == '[' && ep.host.back() == ']')
+        ep.host = ep.host.substr(1, ep.host.length() - 2);
+    }
+
+    return ep;
+  }
+
+
+#if defined (_WIN32)
+  int connect_socket(const endpoint&)
+  {
+    throw std::runtime_error("socket endpoints not supported on this platform");
+  }
+
+
+  int listen_socket(const endpoint&)
+  {
+    throw std::runtime_error("socket endpoints not supported on this platform");
+  }
+#else
+  namespace
+  {
+    sockaddr_un unix_address(const endpoint& ep)
+    {
+      sockaddr_un addr = {};
+      addr.sun_family = AF_UNIX;
+
+      if (ep.path.length() >= sizeof(addr.sun_path))
+        throw std::invalid_argument("endpoint path too long (" + ep.path + ")");
+
+      memcpy(addr.sun_path, ep.path.c_str(), ep.path.length() + 1);
+      return addr;
+    }
+
+    addrinfo* resolve(const endpoint& ep, bool passive)
+    {
+      addrinfo hints = {};
+      hints.ai_family = AF_UNSPEC;
+      hints.ai_socktype = SOCK_STREAM;
+      hints.ai_flags = passive ? AI_PASSIVE : 0;
+
+      addrinfo* result = nullptr;
+      int error = getaddrinfo(ep.host.empty() ? nullptr : ep.host.c_str(), ep.service.c_str(), &hints, &result);
+      if (error != 0)
+        throw std::runtime_error(std::string("resolve endpoint failure (") + gai_strerror(error) + ")");
+
+      return result;
+    }
+  }
+
+
+  int connect_socket(const endpoint& ep)
+  {
+    if (ep.kind == endpoint::kinds::unix_socket)
+    {
+      sockaddr_un addr = unix_address(ep);
+
+      int handle = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+      if (handle == -1)
+        throw std::system_error(errno, std::generic_category(), "socket failure");
+
+      if (::connect(handle, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0)
+      {
+        int error = errno;
+        ::close(handle);
+        throw std::system_error(error, std::generic_category(), "connect failure");
+      }
+      return handle;
+    }
+    else if (ep.kind == endpoint::kinds::tcp)
+    {
+      addrinfo* result = resolve(ep, false);
+
+      int handle = -1, error = 0;
+      for (addrinfo* ai = result; ai && handle == -1; ai = ai->ai_next)
+      {
+        handle = ::socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+        if (handle != -1 && ::connect(handle, ai->ai_addr, ai->ai_addrlen) != 0)
+        {
+          error = errno;
+          ::close(handle);
+          handle = -1;
+        }
+      }
+      freeaddrinfo(result);
+
+      if (handle == -1)
+        throw std::system_error(error, std::generic_category(), "connect failure");
+
+      // Frames are tiny and latency matters more than packing
+      int on = 1;
+      setsockopt(handle, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+      return handle;
+    }
+
+    throw std::invalid_argument("endpoint is not a socket");
+  }
+
+
+  int listen_socket(const endpoint& ep)
+  {
+    int handle = -1;
+
+    if (ep.kind == endpoint::kinds::unix_socket)
+    {
+      sockaddr_un addr = unix_address(ep);
+
+      handle = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+      if (handle == -1)
+        throw std::system_error(errno, std::generic_category(), "socket failure");
+
+      ::unlink(ep.path.c_str()); // Stale socket from a previous run
+      if (::bind(handle, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0)
+      {
+        int error = errno;
+        ::close(handle);
+        throw std::system_error(error, std::generic_category(), "bind failure");
+      }
+    }
+    else if (ep.kind == endpoint::kinds::tcp)
+    {
+      addrinfo* result = resolve(ep, true);
+
+      int error = 0;
+      for (addrinfo* ai = result; ai && handle == -1; ai = ai->ai_next)
+      {
+        handle = ::socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC | SOCK_NONBLOCK, ai->ai_protocol);
+        if (handle == -1)
+        {
+          error = errno;
+          continue;
+        }
+
+        int on = 1;
+        setsockopt(handle, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+        if (::bind(handle, ai->ai_addr, ai->ai_addrlen) != 0)
+        {
+          error = errno;
+          ::close(handle);
+          handle = -1;
+        }
+      }
+      freeaddrinfo(result);
+
+      if (handle == -1)
+        throw std::system_error(error, std::generic_category(), "bind failure");
+    }
+    else
+    {
+      throw std::invalid_argument("endpoint is not a socket");
+    }
+
+    if (::listen(handle, SOMAXCONN) != 0)
+    {
+      int error = errno;
+      ::close(handle);
+      throw std::system_error(error, std::generic_category(), "listen failure");
+    }
+
+    return handle;
+  }
+#endif
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <string>
+
+
+namespace core
+{
+  /**
+   * @brief A serial transport address
+   *
+   * Anything without a recognised scheme is a device name (COM1,
+   * /dev/ttyUSB0). Otherwise one of:
+   *   pty://             a new pseudo-terminal
+   *   tcp://host:port    a TCP socket, an empty host listens on every interface
+   *   unix:///path       a Unix domain socket
+   */
+  struct endpoint
+  {
+    enum class kinds
+    {
+      device,
+      pty,
+      tcp,
+      unix_socket,
+    };
+
+    kinds kind;
+    std::string host;
+    std::string service;
+    std::string path;
+
+    /**
+     * @brief Split an address into its parts
+     *
+     * @param[in] address The address
+     */
+    static endpoint parse(const std::string& address);
+
+    /**
+     * @brief Returns true for the socket based kinds
+     */
+    bool is_socket() const
+    {
+      return kind == kinds::tcp || kind == kinds::unix_socket;
+    }
+  };
+
+  /**
+   * @brief Open a connected socket to a tcp:// or unix:// endpoint
+   *
+   * @param[in] ep The endpoint to connect to
+   * @return The socket descriptor
+   */
+  int connect_socket(const endpoint& ep);
+
+  /**
+   * @brief Open a non-blocking listening socket on a tcp:// or unix:// endpoint
+   *
+   * @param[in] ep The endpoint to listen on
+   * @return The socket descriptor
+   */
+  int listen_socket(const endpoint& ep);
+}
@@ -0,0 +1,98 @@
+#include "frame_parser.h"
+
+
+namespace core
+{
+  namespace
+  {
+    bool is_command(char c)
+    {
+      return static_cast<packet_commands>(c) == packet_commands::read ||
+             static_cast<packet_commands>(c) == packet_commands::write;
+    }
+  }
+
+
+  frame_parser::frame_parser(const dispatcher& d)
+    : dispatcher_(d)
+    , expected_(0)
+    , discarded_(0)
+    , error_(errors::none)
+  {}
+
+
+  frame_parser::results frame_parser::parse(std::string_view data, size_t& length)
+  {
+    length = 0;
+
+    if (expected_ == 0)
+    {
+      if (data.empty())
+        return results::incomplete;
+
+      if (data.size() >= 2)
+        expected_ = frame_length(static_cast<packet_commands>(data[0]), static_cast<packet_types>(data[1]));
+
+      if (!is_command(data[0]))
+        return reject(data, errors::unknown_command, length);
+
+      if (expected_ == 0 && data.size() >= 2)
+        return reject(data, errors::unknown_type, length);
+
+      if (expected_ == 0)
+        return results::incomplete;
+    }
+
+    if (data.size() < expected_)
+      return results::incomplete;
+
+    // Reads of the configuration blocks are just the header, everything else carries a checksum
+    if (expected_ > 2)
+    {
+      uint8_t checksum = 0;
+      for (size_t i = 1; i < expected_ - 1; i++)
+      {
+        checksum += static_cast<uint8_t>(data[i]);
+      }
+
+      if (checksum != static_cast<uint8_t>(data[expected_ - 1]))
+      {
+        // Not a frame after all, look for the next header from the following byte
+        expected_ = 0;
+        return reject(data, errors::checksum, length);
+      }
+    }
+
+    length = expected_;
+    expected_ = 0;
+    return results::frame;
+  }
+
+
+  frame_parser::results frame_parser::reject(std::string_view data, errors error, size_t& length)
+  {
+    // Skip ahead to the next byte that could start a request
+    length = 1;
+    while (length < data.size() && !is_command(data[length]))
+    {
+      length++;
+    }
+
+    discarded_ += length;
+    error_ = error;
+    return results::garbage;
+  }
+
+
+  void frame_parser::reset()
+  {
+    expected_ = 0;
+  }
+
+
+  size_t frame_parser::frame_length(packet_commands command, packet_types type) const
+  {
+    const dispatcher::entry* entry = dispatcher_.find(command, type);
+    return entry ? entry->length : 0;
+  }
+}
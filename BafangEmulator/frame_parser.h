@@ -0,0 +1,90 @@
+#pragma once
+#include "dispatcher.h"
+#include <cstddef>
+#include <string_view>
+
+
+namespace core
+{
+  /**
+   * @brief Splits the received byte stream into request frames
+   *
+   * The length of every frame is known from its (command, type) header, as
+   * registered with the dispatcher, so
+   * exactly one frame is consumed at a time and pipelined requests stay
+   * buffered. A frame split across reads is resumed once the rest arrives.
+   * Unknown headers and checksum failures are skipped up to the next byte
+   * that could start a request, one garbage result per rejected header.
+   */
+  class frame_parser
+  {
+  public:
+
+    enum class results
+    {
+      incomplete, // More data is needed
+      frame,      // A whole frame of length bytes is at the front
+      garbage,    // length bytes at the front are not a frame and should be dropped
+    };
+
+    enum class errors
+    {
+      none,
+      unknown_command, // The first byte is not a command
+      unknown_type,    // No request is registered for the command and type
+      checksum,        // The frame's checksum does not match
+    };
+
+    /**
+     * @brief Constructs the parser
+     *
+     * @param[in] d The dispatcher that knows the supported requests
+     */
+    frame_parser(const dispatcher& d = dispatcher::instance());
+   ~frame_parser() = default;
+
+    /**
+     * @brief Parse the front of the buffered data
+     *
+     * @param[in] data The buffered data, starting where the last frame or garbage ended
+     * @param[out] length The length of the frame or garbage
+     * @return What is at the front of the data
+     */
+    results parse(std::string_view data, size_t& length);
+
+    /**
+     * @brief Forget a partially received frame, e.g. after the buffer was flushed
+     */
+    void reset();
+
+    /**
+     * @brief Why the last garbage was dropped
+     */
+    errors error() const
+    {
+      return error_;
+    }
+
+    /**
+     * @brief Number of bytes that were skipped as garbage
+     */
+    size_t discarded() const
+    {
+      return discarded_;
+    }
+
+    /**
+     * @brief The length of a request frame, or 0 for an unsupported request
+     */
+    size_t frame_length(packet_commands command, packet_types type) const;
+
+  private:
+
+    results reject(std::string_view data, errors error, size_t& length);
+
+    const dispatcher& dispatcher_;
+    size_t expected_; // Length of the frame whose header has been seen, 0 while looking for one
+    size_t discarded_;
+    errors error_;
+  };
+}
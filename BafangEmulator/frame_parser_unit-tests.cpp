@@ -0,0 +1,84 @@
+#include "gtest/gtest.h"
+#include "frame_parser.h"
+
+
+namespace
+{
+  const std::string read_general = { 0x11, 0x51, 0x04, (char)0xB0, 0x05 };
+  const std::string read_basic = { 0x11, 0x52 };
+}
+
+TEST(frame_parser, pipelined_test)
+{
+  core::frame_parser parser;
+  std::string data = read_general + read_basic + read_general;
+  size_t length = 0;
+
+  EXPECT_EQ(parser.parse(data, length), core::frame_parser::results::frame);
+  EXPECT_EQ(length, 5);
+  data.erase(0, length);
+
+  EXPECT_EQ(parser.parse(data, length), core::frame_parser::results::frame);
+  EXPECT_EQ(length, 2);
+  data.erase(0, length);
+
+  EXPECT_EQ(parser.parse(data, length), core::frame_parser::results::frame);
+  EXPECT_EQ(length, 5);
+  data.erase(0, length);
+
+  EXPECT_EQ(parser.parse(data, length), core::frame_parser::results::incomplete);
+}
+
+TEST(frame_parser, split_test)
+{
+  core::frame_parser parser;
+  size_t length = 0;
+
+  EXPECT_EQ(parser.parse(read_general.substr(0, 1), length), core::frame_parser::results::incomplete);
+  EXPECT_EQ(parser.parse(read_general.substr(0, 3), length), core::frame_parser::results::incomplete);
+  EXPECT_EQ(parser.parse(read_general, length), core::frame_parser::results::frame);
+  EXPECT_EQ(length, 5);
+}
+
+TEST(frame_parser, resync_test)
+{
+  core::frame_parser parser;
+  std::string corrupt = read_general;
+  corrupt[3] = 0x00;
+  std::string data = std::string("\xFF\x00", 2) + corrupt + read_basic;
+  size_t length = 0;
+
+  EXPECT_EQ(parser.parse(data, length), core::frame_parser::results::garbage);
+  EXPECT_EQ(length, 2);
+  data.erase(0, length);
+
+  // The checksum fails, so the header is skipped and the rest scanned again
+  EXPECT_EQ(parser.parse(data, length), core::frame_parser::results::garbage);
+  data.erase(0, length);
+  while (parser.parse(data, length) == core::frame_parser::results::garbage)
+  {
+    data.erase(0, length);
+  }
+
+  EXPECT_EQ(data, read_basic);
+  EXPECT_EQ(length, 2);
+  EXPECT_EQ(parser.discarded(), 2 + corrupt.size());
+}
+
+TEST(frame_parser, error_test)
+{
+  core::frame_parser parser;
+  size_t length = 0;
+
+  EXPECT_EQ(parser.parse(std::string("\x12\x51\x11", 3), length), core::frame_parser::results::garbage);
+  EXPECT_EQ(parser.error(), core::frame_parser::errors::unknown_command);
+  EXPECT_EQ(length, 2);
+
+  EXPECT_EQ(parser.parse(std::string("\x11\x60", 2), length), core::frame_parser::results::garbage);
+  EXPECT_EQ(parser.error(), core::frame_parser::errors::unknown_type);
+
+  // One garbage result for the whole corrupt frame
+  EXPECT_EQ(parser.parse(std::string("\x11\x51\x04\x00\x05\x11\x52", 7), length), core::frame_parser::results::garbage);
+  EXPECT_EQ(parser.error(), core::frame_parser::errors::checksum);
+  EXPECT_EQ(length, 5);
+}
@@ -0,0 +1,153 @@
+#include "listener.h"
+#include "endpoint.h"
+#include "trace.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+
+#if !defined (_WIN32)
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+
+namespace core
+{
+#if defined (_WIN32)
+  listener::listener(const std::string& address)
+    : address_(address)
+    , handle_(nullptr)
+    , delay_(0)
+  {
+    throw std::runtime_error("listener not supported on this platform");
+  }
+
+
+  listener::~listener()
+  {}
+
+
+  bool listener::wait()
+  {
+    return false;
+  }
+
+
+  bool listener::accept(serial&)
+  {
+    return false;
+  }
+
+
+  void listener::close()
+  {}
+#else
+  listener::listener(const std::string& address)
+    : address_(address)
+    , handle_(-1)
+    , delay_(0)
+  {
+    endpoint ep = endpoint::parse(address);
+    if (!ep.is_socket())
+      throw std::invalid_argument("listen endpoint must be tcp:// or unix:// (" + address + ")");
+
+    handle_ = listen_socket(ep);
+
+    if (ep.kind == endpoint::kinds::unix_socket)
+      path_ = ep.path;
+
+    TRACE_MESSAGE("listening->%s", address_.c_str());
+  }
+
+
+  listener::~listener()
+  {
+    close();
+  }
+
+
+  bool listener::wait()
+  {
+    while (handle_ != -1)
+    {
+      // Sit out a backoff, the waiting client would only make the poll return at once
+      auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(resume_ - clock::now()).count();
+      if (wait > 0)
+      {
+        std::this_thread::sleep_for(std::chrono::milliseconds(wait < 100 ? wait : 100));
+        continue;
+      }
+
+      pollfd fd = { handle_, POLLIN, 0 };
+      int ready = ::poll(&fd, 1, 100);
+
+      if (ready > 0)
+        return true;
+      else if (ready < 0 && errno != EINTR)
+        throw std::system_error(errno, std::generic_category(), "listener poll failure");
+    }
+    return false;
+  }
+
+
+  bool listener::accept(serial& s)
+  {
+    if (clock::now() < resume_)
+      return false;
+
+    int client = ::accept4(handle_, nullptr, nullptr, SOCK_CLOEXEC);
+    if (client == -1)
+    {
+      switch (errno)
+      {
+        case EAGAIN:
+#if EWOULDBLOCK != EAGAIN
+        case EWOULDBLOCK:
+#endif
+        case EINTR:
+          return false;
+
+        case ECONNABORTED:
+          TRACE_MESSAGE("listener->%s client aborted before accept", address_.c_str());
+          return false;
+
+        case EMFILE:
+        case ENFILE:
+        case ENOBUFS:
+        case ENOMEM:
+          // The client stays queued, retrying at once would only fail again
+          delay_ = delay_.count() ? std::min(delay_ * 2, std::chrono::milliseconds(1000)) : std::chrono::milliseconds(10);
+          resume_ = clock::now() + delay_;
+          TRACE_MESSAGE("listener->%s accept failure (%s), retrying in %lld ms", address_.c_str(), strerror(errno),
+                        static_cast<long long>(delay_.count()));
+          return false;
+
+        default:
+          throw std::system_error(errno, std::generic_category(), "accept failure");
+      }
+    }
+
+    delay_ = std::chrono::milliseconds(0);
+    s.adopt(client, address_);
+    return true;
+  }
+
+
+  void listener::close()
+  {
+    if (handle_ != -1)
+    {
+      int temp = handle_;
+      handle_ = -1;
+      ::close(temp);
+
+      if (!path_.empty())
+        ::unlink(path_.c_str());
+    }
+  }
+#endif
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include "serial.h"
+#include <chrono>
+#include <string>
+
+
+namespace core
+{
+  /**
+   * @brief Accepts clients on a tcp:// or unix:// endpoint, each client
+   * becoming its own serial session
+   */
+  class listener
+  {
+  public:
+
+    using clock = std::chrono::steady_clock;
+
+    /**
+     * @brief Start listening
+     *
+     * @param[in] address The endpoint, e.g. tcp://:5000 or unix:///tmp/bafang.sock
+     */
+    listener(const std::string& address);
+
+    listener(listener&&) = delete;
+    listener(const listener&) = delete;
+    listener& operator=(listener&&) = delete;
+    listener& operator=(const listener&) = delete;
+   ~listener();
+
+    /**
+     * @brief Block until a client is waiting to be accepted
+     *
+     * @return false once the listener has been closed
+     */
+    bool wait();
+
+    /**
+     * @brief Accept a waiting client without blocking
+     *
+     * Running out of descriptors is not an error: the client is left
+     * waiting and accepting backs off, doubling up to a second, until a
+     * client is accepted again.
+     *
+     * @param[out] s The serial session adopting the client
+     * @return false if no client was waiting, or one could not be accepted yet
+     */
+    bool accept(serial& s);
+
+    /**
+     * @brief When to try accepting again, after accept() ran out of descriptors
+     *
+     * @return A time in the past when accept() is not backing off
+     */
+    clock::time_point resume() const
+    {
+      return resume_;
+    }
+
+    /**
+     * @brief Stop listening
+     */
+    void close();
+
+    const std::string& address() const
+    {
+      return address_;
+    }
+
+    serial::native_handle_type native_handle() const
+    {
+      return handle_;
+    }
+
+  private:
+
+    std::string address_;
+    std::string path_;
+    serial::native_handle_type handle_;
+    std::chrono::milliseconds delay_;
+    clock::time_point resume_;
+  };
+}
@@ -0,0 +1,120 @@
+#pragma once
+#include <chrono>
+#include <deque>
+#include <string>
+#include <string_view>
+
+
+namespace core
+{
+  /**
+   * @brief Holds back written data until a real line would have finished
+   * sending it
+   *
+   * Each write occupies the line for size * bits per byte / baud seconds,
+   * multiplied by the time scale, and queues behind any write still on the
+   * line. The data is released in one piece once its last byte would have
+   * arrived. A time scale of 0 disables pacing.
+   */
+  class pacer
+  {
+  public:
+
+    using clock = std::chrono::steady_clock;
+
+    pacer()
+      : baud_(9600)
+      , bits_(10)
+      , scale_(0.0)
+    {}
+
+    /**
+     * @brief Set the line speed
+     *
+     * @param[in] baud The baud rate
+     * @param[in] bits The bits per character, including start, parity and stop bits
+     */
+    void param(unsigned long baud, unsigned int bits)
+    {
+      baud_ = baud ? baud : 1;
+      bits_ = bits;
+    }
+
+    /**
+     * @brief Set the time scale, 1.0 is real time, 0.01 is 100x faster and 0 disables pacing
+     */
+    void time_scale(double scale)
+    {
+      scale_ = scale > 0.0 ? scale : 0.0;
+    }
+
+    bool enabled() const
+    {
+      return scale_ > 0.0;
+    }
+
+    /**
+     * @brief Queue data behind anything still on the line
+     *
+     * @param[in] data The data to send
+     */
+    void push(std::string_view data)
+    {
+      auto now = clock::now();
+      if (line_free_ < now)
+        line_free_ = now;
+
+      double seconds = static_cast<double>(data.size()) * bits_ / baud_ * scale_;
+      line_free_ += std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(seconds));
+      pending_.push_back({ line_free_, std::string(data) });
+    }
+
+    /**
+     * @brief When the next queued data is due, clock::time_point::max() if nothing is queued
+     */
+    clock::time_point deadline() const
+    {
+      return pending_.empty() ? clock::time_point::max() : pending_.front().due;
+    }
+
+    /**
+     * @brief Hand every piece of data that is now due to the writer
+     *
+     * @param[in] write Called with each due std::string, in order
+     */
+    template<class Write>
+    void transmit(Write&& write)
+    {
+      auto now = clock::now();
+      while (!pending_.empty() && pending_.front().due <= now)
+      {
+        std::string data = std::move(pending_.front().data);
+        pending_.pop_front();
+        write(data);
+      }
+    }
+
+    /**
+     * @brief Drop anything still queued, e.g. when the port closes
+     */
+    void clear()
+    {
+      pending_.clear();
+      line_free_ = clock::time_point();
+    }
+
+  private:
+
+    struct pending
+    {
+      clock::time_point due;
+      std::string data;
+    };
+
+    unsigned long baud_;
+    unsigned int bits_;
+    double scale_;
+    clock::time_point line_free_;
+    std::deque<pending> pending_;
+  };
+}
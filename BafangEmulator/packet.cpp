@@ -1,30 +1,27 @@
 #include "packet.h"
+#include <cstring>
 
 
 namespace core
 {
-  void deserialize(const std::string& data, uint8_t* ptr, size_t size) noexcept(false)
+  void deserialize(std::string_view data, uint8_t* ptr, size_t size) noexcept(false)
   {
     if (data.size() < size)
     {
       throw std::runtime_error("packet truncation");
     }
 
-    for (size_t i = 0; i < size; i++)
-    {
-      *ptr++ = data[i];
-    }
+    memcpy(ptr, data.data(), size);
   }
 
   std::string serialize(const uint8_t* ptr, size_t size) noexcept
   {
-    std::string temp;
-
-    for (size_t i = 0; i < size; i++)
-    {
-      temp += *ptr++;
-    }
+    return std::string(reinterpret_cast<const char*>(ptr), size);
+  }
 
-    return temp;
+  size_t serialize(const uint8_t* ptr, size_t size, char* out) noexcept
+  {
+    memcpy(out, ptr, size);
+    return size;
   }
-}
\ No newline at end of file
+}
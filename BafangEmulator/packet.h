@@ -1,15 +1,37 @@
 #pragma once
 #include "packet_types.h"
+#include <array>
 #include <cstdio>
 #include <cstdint>
 #include <string>
+#include <string_view>
 #include <stdexcept>
+#include <type_traits>
 
 
 namespace core
 {
-  void deserialize(const std::string& data, uint8_t* ptr, size_t size) noexcept(false);
+  void deserialize(std::string_view data, uint8_t* ptr, size_t size) noexcept(false);
   std::string serialize(const uint8_t* ptr, size_t size) noexcept;
+  size_t serialize(const uint8_t* ptr, size_t size, char* out) noexcept;
+
+  /**
+   * @brief Serialize a packet into a caller provided buffer, without allocating
+   *
+   * @param[in] packet The packet, any type with a constexpr packet_size()
+   * @param[out] out The buffer, at least packet_size() bytes from offset
+   * @param[in] offset Where in the buffer the packet starts
+   * @return The offset following the packet
+   */
+  template<class Packet, size_t N>
+  size_t serialize_into(const Packet& packet, std::array<char, N>& out, size_t offset = 0) noexcept(false)
+  {
+    static_assert(N >= Packet::packet_size(), "buffer smaller than the packet");
+    if (offset + Packet::packet_size() > N)
+      throw std::runtime_error("packet overflow");
+
+    return offset + serialize(reinterpret_cast<const uint8_t*>(&packet), Packet::packet_size(), out.data() + offset);
+  }
 
 #pragma pack(push, 1)
   template<class T>
@@ -40,7 +62,7 @@ namespace core
    ~request_packet()
     {}
 
-    void deserialize(const std::string& data) noexcept(false)
+    void deserialize(std::string_view data) noexcept(false)
     {
       core::deserialize(data, reinterpret_cast<uint8_t*>(this), packet_size());
 
@@ -53,6 +75,15 @@ namespace core
       return core::serialize(reinterpret_cast<const uint8_t*>(this), packet_size());
     }
 
+    /**
+     * @brief Serialize into a caller provided buffer, see core::serialize_into()
+     */
+    template<size_t N>
+    size_t serialize(std::array<char, N>& out, size_t offset = 0) const noexcept(false)
+    {
+      return serialize_into(*this, out, offset);
+    }
+
     verify_t verify() const noexcept
     {
       verify_t checksum = static_cast<uint8_t>(type) + size;
@@ -76,7 +107,7 @@ namespace core
       return packet_size();
     }
 
-    static length_t packet_size()
+    static constexpr length_t packet_size()
     {
       return static_cast<length_t>(sizeof(request_packet<valuetype>));
     }
@@ -104,7 +135,7 @@ namespace core
    ~response_packet()
     {}
 
-    void deserialize(const std::string& data) noexcept(false)
+    void deserialize(std::string_view data) noexcept(false)
     {
       core::deserialize(data, reinterpret_cast<uint8_t*>(this), packet_size());
     }
@@ -114,6 +145,15 @@ namespace core
       return core::serialize(reinterpret_cast<const uint8_t*>(this), packet_size());
     }
 
+    /**
+     * @brief Serialize into a caller provided buffer, see core::serialize_into()
+     */
+    template<size_t N>
+    size_t serialize(std::array<char, N>& out, size_t offset = 0) const noexcept(false)
+    {
+      return serialize_into(*this, out, offset);
+    }
+
     const char* data() const
     {
       return reinterpret_cast<const char*>(this);
@@ -124,7 +164,7 @@ namespace core
       return packet_size();
     }
 
-    static length_t packet_size()
+    static constexpr length_t packet_size()
     {
       return static_cast<length_t>(sizeof(response_packet<valuetype>));
     }
@@ -151,7 +191,7 @@ namespace core
    ~response_status_packet()
     {}
 
-    void deserialize(const std::string& data) noexcept(false)
+    void deserialize(std::string_view data) noexcept(false)
     {
       core::deserialize(data, reinterpret_cast<uint8_t*>(this), packet_size());
     }
@@ -161,6 +201,15 @@ namespace core
       return core::serialize(reinterpret_cast<const uint8_t*>(this), packet_size());
     }
 
+    /**
+     * @brief Serialize into a caller provided buffer, see core::serialize_into()
+     */
+    template<size_t N>
+    size_t serialize(std::array<char, N>& out, size_t offset = 0) const noexcept(false)
+    {
+      return serialize_into(*this, out, offset);
+    }
+
     const char* data() const
     {
       return reinterpret_cast<const char*>(this);
@@ -171,10 +220,130 @@ namespace core
       return packet_size();
     }
 
-    static length_t packet_size()
+    static constexpr length_t packet_size()
     {
       return static_cast<length_t>(sizeof(response_status_packet));
     }
   };
 #pragma pack(pop)
+
+  /**
+   * @brief Marks a frame the frame_parser has already checked, see packet_view
+   */
+  struct verified_frame_t
+  {
+    explicit verified_frame_t() = default;
+  };
+  inline constexpr verified_frame_t verified_frame{};
+
+  /**
+   * @brief A request frame decoded in place over the received bytes
+   *
+   * The checksum is computed in the same pass that checks the frame is
+   * whole, so a frame goes from the receive buffer to validation without
+   * being copied. A frame the frame_parser yielded has had its checksum
+   * checked already and is viewed with verified_frame, which sums nothing.
+   * The bytes must stay buffered while the view is used.
+   */
+  template<class T>
+  class packet_view
+  {
+  public:
+
+    typedef T valuetype;
+
+    explicit packet_view(std::string_view data) noexcept(false)
+      : data_(reinterpret_cast<const uint8_t*>(data.data()))
+      , checksum_(0)
+    {
+      if (data.size() < packet_size())
+        throw std::runtime_error("packet truncation");
+
+      // Type, size and payload are summed, the command and verification are not
+      for (size_t i = 1; i + 1 < packet_size(); i++)
+      {
+        checksum_ += data_[i];
+      }
+    }
+
+    packet_view(std::string_view data, verified_frame_t) noexcept(false)
+      : data_(reinterpret_cast<const uint8_t*>(data.data()))
+      , checksum_(0)
+    {
+      if (data.size() < packet_size())
+        throw std::runtime_error("packet truncation");
+
+      checksum_ = verification();
+    }
+
+    packet_commands command() const
+    {
+      return static_cast<packet_commands>(data_[0]);
+    }
+
+    packet_types type() const
+    {
+      return static_cast<packet_types>(data_[1]);
+    }
+
+    length_t size() const
+    {
+      return data_[2];
+    }
+
+    verify_t verification() const
+    {
+      return data_[packet_size() - 1];
+    }
+
+    verify_t verify() const
+    {
+      return checksum_;
+    }
+
+    bool valid() const
+    {
+      return checksum_ == verification();
+    }
+
+    /**
+     * @brief The payload as laid out on the wire, single byte fields can be read directly
+     */
+    const valuetype& payload() const
+    {
+      return *reinterpret_cast<const valuetype*>(data_ + 3);
+    }
+
+    const valuetype* operator->() const
+    {
+      return &payload();
+    }
+
+    /**
+     * @brief Decode a multi-byte payload field, which is little-endian on the wire
+     *
+     * @param[in] field The field, e.g. view.get(view->hardware_version)
+     */
+    template<class U>
+    U get(const U& field) const
+    {
+      const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&field);
+      typename std::make_unsigned<U>::type value = 0;
+      for (size_t i = sizeof(U); i > 0; i--)
+      {
+        value = static_cast<decltype(value)>((value << 8) | bytes[i - 1]);
+      }
+      return static_cast<U>(value);
+    }
+
+    static constexpr length_t packet_size()
+    {
+      return static_cast<length_t>(sizeof(request_packet<valuetype>));
+    }
+
+  private:
+
+    const uint8_t* data_;
+    verify_t checksum_;
+  };
 }
@@ -0,0 +1,44 @@
+#pragma once
+#include "packet_types.h"
+#include "packet_basic.h"
+#include "packet_pedal.h"
+#include "packet_throttle.h"
+#include <cstdint>
+
+
+namespace core
+{
+#pragma pack(push, 1)
+  /**
+   * @brief Full flash write (wrAll), every writable block back-to-back
+   *
+   * The full flash read (rdAll) is just the command and type, answered with
+   * the general, basic, pedal and throttle responses back-to-back.
+   */
+  struct request_all
+  {
+    static const packet_types packet_type = packet_types::all;
+
+    request_basic basic;
+    request_pedal pedal;
+    request_throttle throttle;
+  };
+#pragma pack(pop)
+
+  /**
+   * @brief Full flash write result, the blocks are only stored when all succeed
+   */
+  struct response_status_all
+  {
+    response_status_basic basic;
+    response_status_pedal pedal;
+    response_status_throttle throttle;
+
+    bool success() const
+    {
+      return basic == response_status_basic::success &&
+             pedal == response_status_pedal::success &&
+             throttle == response_status_throttle::success;
+    }
+  };
+}
@@ -1,7 +1,35 @@
 #pragma once
 #include "packet_types.h"
+#include "packet_schema.h"
 #include <cstdint>
 
+// The status codes interleave the assist currents and speeds, unlike the wire order
+#define PACKET_BASIC_SCHEMA(FIELD, CUSTOM) \
+  FIELD(low_battery,      0, "LBP",    20, 0, 255, -1) \
+  FIELD(current_limit,    1, "LC",     25, 1, 255, -1) \
+  FIELD(assist0_current,  2, "ALC0",   10, 1, 100, -1) \
+  FIELD(assist1_current,  4, "ALC1",   20, 1, 100, -1) \
+  FIELD(assist2_current,  6, "ALC2",   30, 1, 100, -1) \
+  FIELD(assist3_current,  8, "ALC3",   40, 1, 100, -1) \
+  FIELD(assist4_current, 10, "ALC4",   50, 1, 100, -1) \
+  FIELD(assist5_current, 12, "ALC5",   60, 1, 100, -1) \
+  FIELD(assist6_current, 14, "ALC6",   70, 1, 100, -1) \
+  FIELD(assist7_current, 16, "ALC7",   80, 1, 100, -1) \
+  FIELD(assist8_current, 18, "ALC8",   90, 1, 100, -1) \
+  FIELD(assist9_current, 20, "ALC9",  100, 1, 100, -1) \
+  FIELD(assist0_speed,    3, "ALBP0",  10, 1, 100, -1) \
+  FIELD(assist1_speed,    5, "ALBP1",  20, 1, 100, -1) \
+  FIELD(assist2_speed,    7, "ALBP2",  30, 1, 100, -1) \
+  FIELD(assist3_speed,    9, "ALBP3",  40, 1, 100, -1) \
+  FIELD(assist4_speed,   11, "ALBP4",  50, 1, 100, -1) \
+  FIELD(assist5_speed,   13, "ALBP5",  60, 1, 100, -1) \
+  FIELD(assist6_speed,   15, "ALBP6",  70, 1, 100, -1) \
+  FIELD(assist7_speed,   17, "ALBP7",  80, 1, 100, -1) \
+  FIELD(assist8_speed,   19, "ALBP8",  90, 1, 100, -1) \
+  FIELD(assist9_speed,   21, "ALBP9", 100, 1, 100, -1) \
+  CUSTOM(wheel_size,     22) \
+  CUSTOM(speed_meter,    23)
+
 
 namespace core
 {
@@ -9,70 +37,19 @@ namespace core
   struct response_basic
   {
     static const packet_types packet_type = packet_types::basic;
+    static constexpr const char* profile_section = "Basic";
 
-    uint8_t low_battery;
-    uint8_t current_limit;
-
-    uint8_t assist0_current;
-    uint8_t assist1_current;
-    uint8_t assist2_current;
-    uint8_t assist3_current;
-    uint8_t assist4_current;
-    uint8_t assist5_current;
-    uint8_t assist6_current;
-    uint8_t assist7_current;
-    uint8_t assist8_current;
-    uint8_t assist9_current;
-
-    uint8_t assist0_speed;
-    uint8_t assist1_speed;
-    uint8_t assist2_speed;
-    uint8_t assist3_speed;
-    uint8_t assist4_speed;
-    uint8_t assist5_speed;
-    uint8_t assist6_speed;
-    uint8_t assist7_speed;
-    uint8_t assist8_speed;
-    uint8_t assist9_speed;
-
-    uint8_t wheel_size;
-
-    uint8_t speed_meter;
+    PACKET_BASIC_SCHEMA(PACKET_SCHEMA_MEMBER, PACKET_SCHEMA_MEMBER)
   };
 
   using request_basic = response_basic;
 
   enum class response_status_basic : uint8_t
   {
-    low_battery,
-    current_limit,
-
-    assist0_current,
-    assist0_speed,
-    assist1_current,
-    assist1_speed,
-    assist2_current,
-    assist2_speed,
-    assist3_current,
-    assist3_speed,
-    assist4_current,
-    assist4_speed,
-    assist5_current,
-    assist5_speed,
-    assist6_current,
-    assist6_speed,
-    assist7_current,
-    assist7_speed,
-    assist8_current,
-    assist8_speed,
-    assist9_current,
-    assist9_speed,
-
-    wheel_size,
-
-    speed_meter,
-
-    success,
+    PACKET_BASIC_SCHEMA(PACKET_SCHEMA_STATUS, PACKET_SCHEMA_STATUS)
+    success = 24,
   };
 #pragma pack(pop)
-}
\ No newline at end of file
+
+  static_assert(sizeof(response_basic) == 24, "basic block layout");
+}
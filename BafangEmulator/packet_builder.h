@@ -5,19 +5,56 @@
 #include "packet_basic.h"
 #include "packet_pedal.h"
 #include "packet_throttle.h"
+#include "packet_all.h"
 
 
 namespace core
 {
   namespace packet_builder
   {
+    // Wheel diameters 16" to 30" as sent on the wire, the profile stores the index
+    constexpr uint8_t wheels[] = { 16<<1,17<<1,18<<1,19<<1,20<<1,21<<1,22<<1,23<<1,24<<1,25<<1,26<<1,27<<1,27<<1|1,28<<1,29<<1,30<<1 };
+
+    constexpr bool in_range(uint8_t value, int min, int max, int also)
+    {
+      return (value >= min && value <= max) || value == also;
+    }
+
+    constexpr bool valid_wheel_size(uint8_t value)
+    {
+      for (uint8_t wheel : wheels)
+      {
+        if (wheel == value)
+          return true;
+      }
+      return false;
+    }
+
+    // Speed meter model in the top two bits, signals in the rest
+    constexpr bool valid_speed_meter(uint8_t value)
+    {
+      return value / 64 <= 2 && value % 64 <= 36 && value % 64 != 0;
+    }
+
     void build(response_packet<response_general>& response, profile& general);
     void build(response_packet<response_basic>& response, profile& config);
     void build(response_packet<response_pedal>& response, profile& config);
     void build(response_packet<response_throttle>& response, profile& config);
 
-    response_status_basic parse(const request_packet<request_basic>& request, profile& config);
-    response_status_pedal parse(const request_packet<request_pedal>& request, profile& config);
-    response_status_throttle parse(const request_packet<request_throttle>& request, profile& config);
+    // Validate a write and store it in the profile, which is saved only on success
+    response_status_basic parse(const request_basic& request, profile& config);
+    response_status_pedal parse(const request_pedal& request, profile& config);
+    response_status_throttle parse(const request_throttle& request, profile& config);
+    response_status_all parse(const request_all& request, profile& config);
+
+    // Validate a write into a working copy of the profile, without saving
+    response_status_basic apply(const request_basic& request, profile& temp);
+    response_status_pedal apply(const request_pedal& request, profile& temp);
+    response_status_throttle apply(const request_throttle& request, profile& temp);
+
+    // Check every field of a write, bit n of the result is set when status code n applies
+    uint32_t validate(const request_basic& request);
+    uint32_t validate(const request_pedal& request);
+    uint32_t validate(const request_throttle& request);
   }
 }
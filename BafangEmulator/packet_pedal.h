@@ -1,7 +1,21 @@
 #pragma once
 #include "packet_types.h"
+#include "packet_schema.h"
 #include <cstdint>
 
+#define PACKET_PEDAL_SCHEMA(FIELD, CUSTOM) \
+  FIELD(sensor_type,      0, "PT",   3, 0,   4,  -1) \
+  FIELD(assist_level,     1, "DA",   0, 0,   9, 255) \
+  FIELD(speed_limit,      2, "SL",   0, 0,  99, 255) \
+  FIELD(start_current,    3, "SC",  20, 1,  20,  -1) \
+  FIELD(slow_start_mode,  4, "SSM",  5, 1,   8,  -1) \
+  FIELD(start_deg,        5, "SDN", 20, 1, 100,  -1) \
+  FIELD(work_mode,        6, "WM",   0, 0, 255,  -1) \
+  FIELD(stop_delay,       7, "TS",  25, 0, 255,  -1) \
+  FIELD(current_decay,    8, "CD",   8, 1,   8,  -1) \
+  FIELD(stop_decay,       9, "SD",  20, 0, 255,  -1) \
+  FIELD(keep_current,    10, "KC",  20, 1, 100,  -1)
+
 
 namespace core
 {
@@ -9,40 +23,19 @@ namespace core
   struct response_pedal
   {
     static const packet_types packet_type = packet_types::pedal;
+    static constexpr const char* profile_section = "Pedal Assist";
 
-    uint8_t sensor_type;
-    uint8_t assist_level;
-    uint8_t speed_limit;
-    uint8_t start_current;
-
-    uint8_t slow_start_mode;
-    uint8_t start_deg;
-    uint8_t work_mode;
-
-    uint8_t stop_delay;
-    uint8_t current_decay;
-    uint8_t stop_decay;
-    uint8_t keep_current;
+    PACKET_PEDAL_SCHEMA(PACKET_SCHEMA_MEMBER, PACKET_SCHEMA_MEMBER)
   };
 
   using request_pedal = response_pedal;
 
   enum class response_status_pedal : uint8_t
   {
-    sensor_type,
-    assist_level,
-    speed_limit,
-    start_current,
-    
-    slow_start_mode,
-    start_deg,
-    work_mode,
-    
-    stop_delay,
-    current_decay,
-    stop_decay,
-    keep_current,
-    success,
+    PACKET_PEDAL_SCHEMA(PACKET_SCHEMA_STATUS, PACKET_SCHEMA_STATUS)
+    success = 11,
   };
 #pragma pack(pop)
-}
\ No newline at end of file
+
+  static_assert(sizeof(response_pedal) == 11, "pedal assist block layout");
+}
@@ -0,0 +1,23 @@
+/**
+* @file packet_schema.h
+* Generators for the packet block schemas.
+*
+* Each block declares its fields once, in wire order, as a list of
+*   FIELD(name, status, key, default, min, max, also)
+*     name    - member of the payload struct
+*     status  - status code returned when a write is rejected for this field
+*     key     - profile key within the block's profile_section
+*     default - value used when the profile has no key
+*     min/max - accepted range of a write
+*     also    - one more accepted value outside the range (255 "set by display"), -1 for none
+*   CUSTOM(name, status)
+*     a field encoded by hand, packet_builder provides build_<name>() and parse_<name>()
+*
+* The payload struct, the status enum, and packet_builder's build() and
+* parse() are all expanded from the same list.
+*/
+#pragma once
+#include <cstdint>
+
+#define PACKET_SCHEMA_MEMBER(name, ...) uint8_t name;
+#define PACKET_SCHEMA_STATUS(name, status, ...) name = status,
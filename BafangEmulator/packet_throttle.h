@@ -1,7 +1,16 @@
 #pragma once
 #include "packet_types.h"
+#include "packet_schema.h"
 #include <cstdint>
 
+#define PACKET_THROTTLE_SCHEMA(FIELD, CUSTOM) \
+  FIELD(start_volt,    0, "SV",   11, 0,  50,  -1) \
+  FIELD(end_volt,      1, "EV",   35, 0,  50,  -1) \
+  FIELD(mode,          2, "MODE",  0, 0,   1,  -1) \
+  FIELD(assist_level,  3, "DA",    4, 0,   9, 255) \
+  FIELD(speed_limit,   4, "SL",    3, 0,  99, 255) \
+  FIELD(start_current, 5, "SC",   20, 1, 100,  -1)
+
 
 namespace core
 {
@@ -9,26 +18,19 @@ namespace core
   struct response_throttle
   {
     static const packet_types packet_type = packet_types::throttle;
+    static constexpr const char* profile_section = "Throttle Handle";
 
-    uint8_t start_volt;
-    uint8_t end_volt;
-    uint8_t mode;
-    uint8_t assist_level;
-    uint8_t speed_limit;
-    uint8_t start_current;
+    PACKET_THROTTLE_SCHEMA(PACKET_SCHEMA_MEMBER, PACKET_SCHEMA_MEMBER)
   };
 
   using request_throttle = response_throttle;
 
   enum class response_status_throttle : uint8_t
   {
-    start_volt,
-    end_volt,
-    mode,
-    assist_level,
-    speed_limit,
-    start_current,
-    success,
+    PACKET_THROTTLE_SCHEMA(PACKET_SCHEMA_STATUS, PACKET_SCHEMA_STATUS)
+    success = 6,
   };
 #pragma pack(pop)
-}
\ No newline at end of file
+
+  static_assert(sizeof(response_throttle) == 6, "throttle handle block layout");
+}
@@ -16,6 +16,16 @@ namespace core
     basic    = 0x52,   
     pedal    = 0x53, 
     throttle = 0x54,
+    all      = 0x50,   // Every block back-to-back, the rdAll/wrAll full flash transfers
+  };
+
+  // Status byte of a NAK, sent after the offending command or type byte,
+  // outside the range of every block's write status codes
+  enum class nak_codes : uint8_t
+  {
+    unknown_command = 0xFD,
+    unknown_type    = 0xFE,
+    checksum        = 0xFF,
   };
 
   enum class marker_types : uint8_t
@@ -1,6 +1,8 @@
 #include "gtest/gtest.h"
 #include "packet.h"
 #include "packet_general.h"
+#include "packet_builder.h"
+#include <cstdio>
 
 
 TEST(request_packet, general_size_test)
@@ -57,6 +59,17 @@ TEST(response_packet, general_serialize_test)
   EXPECT_EQ(actual, expected);
 }
 
+TEST(response_packet, general_serialize_array_test)
+{
+  core::response_packet<core::response_general> general;
+  general.payload.nominal_voltage = 4;
+
+  std::array<char, core::response_packet<core::response_general>::packet_size() + 2> buffer = {};
+  EXPECT_EQ(general.serialize(buffer, 2), buffer.size());
+  EXPECT_EQ(std::string(buffer.data() + 2, general.length()), general.serialize());
+  EXPECT_THROW(general.serialize(buffer, 3), std::runtime_error);
+}
+
 TEST(request_packet, general_deserialize_test)
 {
   auto test = []
@@ -91,3 +104,105 @@ TEST(response_packet, general_deserialize_test)
 
   EXPECT_NO_THROW(test());
 }
+
+namespace
+{
+#pragma pack(push, 1)
+  struct request_word
+  {
+    static const core::packet_types packet_type = core::packet_types::general;
+
+    uint16_t word;
+  };
+#pragma pack(pop)
+}
+
+TEST(packet_view, general_test)
+{
+  std::string data = { 0x11, 0x51, 0x04, (char)0xB0, 0x05, 0x11, 0x52 };
+  core::packet_view<core::request_general> view(data);
+
+  EXPECT_EQ(view.command(), core::packet_commands::read);
+  EXPECT_EQ(view.type(), core::packet_types::general);
+  EXPECT_EQ(view.size(), 4);
+  EXPECT_EQ(view->unknown, 0xB0);
+  EXPECT_TRUE(view.valid());
+
+  // Decoded in place, not copied
+  EXPECT_EQ(reinterpret_cast<const char*>(&view.payload()), data.data() + 3);
+
+  data[3] = 0x00;
+  EXPECT_FALSE(core::packet_view<core::request_general>(data).valid());
+  EXPECT_THROW(core::packet_view<core::request_general>(data.substr(0, 4)), std::runtime_error);
+
+  // A frame the parser checked is taken as it is, only its length is checked
+  EXPECT_TRUE(core::packet_view<core::request_general>(data, core::verified_frame).valid());
+  EXPECT_THROW(core::packet_view<core::request_general>(data.substr(0, 4), core::verified_frame), std::runtime_error);
+}
+
+TEST(packet_view, little_endian_test)
+{
+  std::string data = { 0x16, 0x51, 0x05, 0x34, 0x12, (char)(0x51 + 0x05 + 0x34 + 0x12) };
+  core::packet_view<request_word> view(data);
+
+  EXPECT_TRUE(view.valid());
+  EXPECT_EQ(view.get(view->word), 0x1234);
+}
+
+TEST(packet_builder, status_code_test)
+{
+  // The wire status codes are not in field order
+  EXPECT_EQ(static_cast<int>(core::response_status_basic::assist0_speed), 3);
+  EXPECT_EQ(static_cast<int>(core::response_status_basic::assist1_current), 4);
+  EXPECT_EQ(static_cast<int>(core::response_status_basic::success), 24);
+  EXPECT_EQ(static_cast<int>(core::response_status_pedal::success), 11);
+  EXPECT_EQ(static_cast<int>(core::response_status_throttle::success), 6);
+}
+
+TEST(packet_builder, basic_round_trip_test)
+{
+  std::remove("packet_test.el");
+  core::profile config("packet_test.el");
+  core::response_packet<core::response_basic> response;
+  core::packet_builder::build(response, config);
+
+  EXPECT_EQ(response.payload.assist3_current, 40);
+  EXPECT_EQ(response.payload.wheel_size, 26 << 1);
+
+  core::request_packet<core::request_basic> request(core::packet_commands::write, core::packet_types::basic);
+  request.payload = response.payload;
+  EXPECT_EQ(core::packet_builder::parse(request.payload, config), core::response_status_basic::success);
+
+  request.payload.assist3_speed = 101;
+  EXPECT_EQ(core::packet_builder::parse(request.payload, config), core::response_status_basic::assist3_speed);
+}
+
+TEST(packet_builder, throttle_display_value_test)
+{
+  std::remove("packet_test.el");
+  core::profile config("packet_test.el");
+  core::request_packet<core::request_throttle> request(core::packet_commands::write, core::packet_types::throttle);
+  request.payload = { 11, 35, 0, 255, 255, 20 };
+
+  // 255 leaves the assist level and speed limit to the display
+  EXPECT_EQ(core::packet_builder::parse(request.payload, config), core::response_status_throttle::success);
+  EXPECT_EQ(config.find("Throttle Handle", "DA", 0), 255);
+
+  request.payload.assist_level = 10;
+  EXPECT_EQ(core::packet_builder::parse(request.payload, config), core::response_status_throttle::assist_level);
+}
+
+TEST(packet_builder, validate_test)
+{
+  std::remove("packet_test.el");
+  core::profile config("packet_test.el");
+  core::response_packet<core::response_basic> response;
+  core::packet_builder::build(response, config);
+  EXPECT_EQ(core::packet_builder::validate(response.payload), 0u);
+
+  // Every failing field is reported, parse only returns the first
+  response.payload.current_limit = 0;
+  response.payload.assist3_speed = 101;
+  EXPECT_EQ(core::packet_builder::validate(response.payload), (1u << 1) | (1u << 9));
+  EXPECT_EQ(core::packet_builder::parse(response.payload, config), core::response_status_basic::current_limit);
+}
@@ -0,0 +1,183 @@
+#include "persister.h"
+#include "exceptions.h"
+#include "trace.h"
+#include <system_error>
+
+#if defined (_WIN32)
+#include <Windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+
+namespace core
+{
+  persister::persister(sync_policy policy, std::chrono::milliseconds linger)
+    : policy_(policy)
+    , linger_(linger)
+    , writing_(false)
+    , stopped_(false)
+    , saves_(0)
+    , writes_(0)
+    , thread_(&persister::run, this)
+  {}
+
+
+  persister::~persister()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopped_ = true;
+    }
+    changed_.notify_all();
+    thread_.join();
+  }
+
+
+  void persister::save(const std::string& path, const profile& p)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      pending_.insert_or_assign(path, p);
+      saves_++;
+    }
+    changed_.notify_all();
+  }
+
+
+  void persister::flush()
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    changed_.wait(lock, [this] { return pending_.empty() && !writing_; });
+  }
+
+
+  unsigned long persister::saves() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return saves_;
+  }
+
+
+  unsigned long persister::writes() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return writes_;
+  }
+
+
+  void persister::run()
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;)
+    {
+      changed_.wait(lock, [this] { return !pending_.empty() || stopped_; });
+      if (pending_.empty())
+        break; // Stopped with nothing left to write
+
+      // Let a burst of saves land before writing, unless shutting down
+      if (!stopped_)
+        changed_.wait_for(lock, linger_, [this] { return stopped_; });
+
+      std::map<std::string, profile> batch;
+      batch.swap(pending_);
+      writing_ = true;
+      lock.unlock();
+
+      for (auto& item : batch)
+      {
+        try
+        {
+          write(item.first, item.second.serialize(), policy_);
+          TRACE_MESSAGE("profile \"%s\" written", item.first.c_str());
+        }
+        catch (...)
+        {
+          // The next save of this profile will try again
+          TRACE_MESSAGE("profile \"%s\" write behind failure", item.first.c_str());
+          exception_handler();
+        }
+      }
+
+      lock.lock();
+      writing_ = false;
+      writes_ += static_cast<unsigned long>(batch.size());
+      changed_.notify_all();
+    }
+  }
+
+
+#if defined (_WIN32)
+  void persister::write(const std::string& path, std::string_view text, sync_policy policy)
+  {
+    std::string temp = path + ".tmp";
+    HANDLE file = CreateFileA(temp.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+      throw std::system_error(GetLastError(), std::system_category(), "save profile failure");
+
+    DWORD written = 0;
+    BOOL ok = WriteFile(file, text.data(), static_cast<DWORD>(text.size()), &written, NULL) && written == text.size();
+    if (ok && policy != sync_policy::none)
+      ok = FlushFileBuffers(file);
+
+    DWORD error = GetLastError();
+    CloseHandle(file);
+    if (!ok)
+      throw std::system_error(error, std::system_category(), "save profile failure");
+
+    // Write through makes the rename itself durable before returning
+    DWORD flags = MOVEFILE_REPLACE_EXISTING | (policy == sync_policy::full ? MOVEFILE_WRITE_THROUGH : 0);
+    if (!MoveFileExA(temp.c_str(), path.c_str(), flags))
+      throw std::system_error(GetLastError(), std::system_category(), "save profile failure");
+  }
+#else
+  void persister::write(const std::string& path, std::string_view text, sync_policy policy)
+  {
+    std::string temp = path + ".tmp";
+    int fd = ::open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+      throw std::system_error(errno, std::generic_category(), "save profile failure");
+
+    // One write for the whole file, looping only if the kernel takes part of it
+    while (!text.empty())
+    {
+      ssize_t written = ::write(fd, text.data(), text.size());
+      if (written < 0 && errno == EINTR)
+        continue;
+
+      if (written < 0)
+      {
+        int error = errno;
+        ::close(fd);
+        throw std::system_error(error, std::generic_category(), "save profile failure");
+      }
+      text.remove_prefix(static_cast<size_t>(written));
+    }
+
+    if (policy != sync_policy::none && ::fsync(fd) != 0)
+    {
+      int error = errno;
+      ::close(fd);
+      throw std::system_error(error, std::generic_category(), "save profile failure");
+    }
+    ::close(fd);
+
+    if (::rename(temp.c_str(), path.c_str()) != 0)
+      throw std::system_error(errno, std::generic_category(), "save profile failure");
+
+    if (policy == sync_policy::full)
+    {
+      auto slash = path.find_last_of('/');
+      std::string directory = slash == std::string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+      int dir = ::open(directory.c_str(), O_RDONLY | O_CLOEXEC);
+      if (dir >= 0)
+      {
+        ::fsync(dir);
+        ::close(dir);
+      }
+    }
+  }
+#endif
+}
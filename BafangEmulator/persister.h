@@ -0,0 +1,96 @@
+#pragma once
+#include "profile.h"
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+
+namespace core
+{
+  /**
+   * @brief Writes profiles to disk from a background thread
+   *
+   * profile::save() hands the persister a copy of the profile and returns,
+   * so the serial threads only wait for memory. A burst of saves to one
+   * file is coalesced into a single write of the latest copy. Files are
+   * written to a temporary file in one write and renamed over the old one,
+   * so a crash leaves either the old profile or the new one, never a part.
+   */
+  class persister
+  {
+  public:
+
+    enum class sync_policy
+    {
+      none,       // Leave flushing to the OS
+      file,       // Flush the file to disk before it is renamed
+      full,       // Also flush the directory, so the rename itself survives a power loss
+    };
+
+    /**
+     * @brief Constructs the persister and starts its thread
+     *
+     * @param[in] policy When to flush written files to disk
+     * @param[in] linger How long to wait after a save for more saves to coalesce
+     */
+    persister(sync_policy policy = sync_policy::file,
+              std::chrono::milliseconds linger = std::chrono::milliseconds(20));
+
+    persister(const persister&) = delete;
+    persister& operator=(const persister&) = delete;
+
+    /**
+     * @brief Writes every pending save, then stops the thread
+     */
+   ~persister();
+
+    /**
+     * @brief Queue a profile to be written, replacing any pending save of the same file
+     *
+     * @param[in] path The profile path
+     * @param[in] p The profile contents
+     */
+    void save(const std::string& path, const profile& p);
+
+    /**
+     * @brief Wait until every queued save is on disk
+     */
+    void flush();
+
+    /**
+     * @brief Number of saves queued, and number of files actually written
+     */
+    unsigned long saves() const;
+    unsigned long writes() const;
+
+    /**
+     * @brief Write a file through a temporary file and an atomic rename
+     *
+     * @param[in] path The file path
+     * @param[in] text The new contents
+     * @param[in] policy When to flush to disk
+     */
+    static void write(const std::string& path, std::string_view text, sync_policy policy);
+
+  protected:
+
+    void run();
+
+  private:
+
+    sync_policy policy_;
+    std::chrono::milliseconds linger_;
+    mutable std::mutex mutex_;
+    std::condition_variable changed_;
+    std::map<std::string, profile> pending_;
+    bool writing_;
+    bool stopped_;
+    unsigned long saves_;
+    unsigned long writes_;
+    std::thread thread_;
+  };
+}
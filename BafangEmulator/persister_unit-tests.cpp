@@ -0,0 +1,51 @@
+#include "gtest/gtest.h"
+#include "persister.h"
+#include <cstdio>
+#include <fstream>
+
+
+TEST(persister, coalesce_test)
+{
+  std::remove("persister_test.el");
+  core::persister persist(core::persister::sync_policy::none, std::chrono::milliseconds(50));
+  core::profile config("persister_test.el");
+  config.persist(&persist);
+
+  // A burst of saves is one write of the latest contents
+  for (int i = 0; i < 100; i++)
+  {
+    config.add(core::keys::basic::current_limit, i);
+    config.save();
+  }
+  persist.flush();
+
+  EXPECT_EQ(persist.saves(), 100u);
+  EXPECT_LT(persist.writes(), 100u);
+  EXPECT_TRUE(core::profile("persister_test.el") == config);
+  EXPECT_FALSE(std::ifstream("persister_test.el.tmp").is_open());
+}
+
+TEST(persister, write_test)
+{
+  std::remove("persister_test.el");
+  core::persister::write("persister_test.el", "[Basic]\nLC=18\n", core::persister::sync_policy::full);
+
+  core::profile config("persister_test.el");
+  EXPECT_EQ(config.get(core::keys::basic::current_limit), 18);
+
+  // serialize() writes the platform newline, so round trip it rather than compare the text
+  core::persister::write("persister_test.el", config.serialize(), core::persister::sync_policy::none);
+  EXPECT_EQ(core::profile("persister_test.el").get(core::keys::basic::current_limit), 18);
+  EXPECT_FALSE(std::ifstream("persister_test.el.tmp").is_open());
+}
+
+TEST(persister, no_filename_test)
+{
+  core::persister persist;
+  core::profile config;
+  config.persist(&persist);
+
+  EXPECT_THROW(config.save(), std::runtime_error);
+  persist.flush();
+  EXPECT_EQ(persist.saves(), 0u);
+}
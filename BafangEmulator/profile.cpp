@@ -1,107 +1,364 @@
 #include "profile.h"
+#include "persister.h"
 #include "trace.h"
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cstring>
+#include <deque>
 #include <fstream>
+#include <iterator>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <unordered_map>
 
 
 namespace core
 {
+  namespace
+  {
+    uint64_t next_version()
+    {
+      static std::atomic<uint64_t> versions(0);
+      return ++versions;
+    }
+
+    /**
+     * @brief The section and key names seen by any profile, and the slot of each pair
+     *
+     * Names are only ever added, so a slot means the same pair in every profile.
+     */
+    class names
+    {
+    public:
+
+      static const size_t npos = SIZE_MAX;
+
+      static names& instance()
+      {
+        static names n;
+        return n;
+      }
+
+      // The keys with handles take the first slots, in the order of their handles
+      names()
+      {
+        for (size_t slot = 0; slot < keys::count; slot++)
+        {
+          if (add(keys::names[slot][0], keys::names[slot][1]) != slot)
+            throw std::logic_error("duplicate profile key");
+        }
+      }
+
+      // The slot of a pair, npos when no profile has used it
+      size_t find(std::string_view section, std::string_view key) const
+      {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        auto s = ids_.find(section);
+        auto k = ids_.find(key);
+        if (s == ids_.end() || k == ids_.end())
+          return npos;
+
+        auto slot = slots_.find(pair(s->second, k->second));
+        return slot != slots_.end() ? slot->second : npos;
+      }
+
+      size_t add(std::string_view section, std::string_view key)
+      {
+        size_t found = find(section, key);
+        if (found != npos)
+          return found;
+
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        uint64_t p = pair(intern(section), intern(key));
+        auto slot = slots_.find(p);
+        if (slot != slots_.end())
+          return slot->second;
+
+        pairs_.push_back(p);
+        slots_.emplace(p, pairs_.size() - 1);
+        return pairs_.size() - 1;
+      }
+
+      // The section and key of a slot, the views stay valid for the life of the process
+      std::pair<std::string_view, std::string_view> name(size_t slot) const
+      {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        return { storage_[pairs_[slot] >> 32], storage_[pairs_[slot] & 0xFFFFFFFF] };
+      }
+
+    private:
+
+      static uint64_t pair(uint32_t section, uint32_t key)
+      {
+        return (static_cast<uint64_t>(section) << 32) | key;
+      }
+
+      uint32_t intern(std::string_view name)
+      {
+        auto found = ids_.find(name);
+        if (found != ids_.end())
+          return found->second;
+
+        storage_.emplace_back(name); // A deque never moves its strings, the views in ids_ stay valid
+        uint32_t id = static_cast<uint32_t>(storage_.size() - 1);
+        ids_.emplace(storage_.back(), id);
+        return id;
+      }
+
+      mutable std::shared_mutex mutex_;
+      std::deque<std::string> storage_;
+      std::unordered_map<std::string_view, uint32_t> ids_;
+      std::unordered_map<uint64_t, size_t> slots_;
+      std::vector<uint64_t> pairs_;
+    };
+  }
+
+
+  profile::profile()
+    : exists_(false)
+    , version_(next_version())
+    , persister_(nullptr)
+    , values_(keys::count, { value::kinds::unset, 0, std::string() })
+  {}
+
+
   profile::profile(const std::string& path)
     : exists_(false)
+    , version_(next_version())
     , filename_(path)
+    , persister_(nullptr)
+    , values_(keys::count, { value::kinds::unset, 0, std::string() })
   {
-    std::ifstream f(filename_);
+    std::ifstream f(filename_, std::ios::binary);
     if (f.is_open())
     {
       exists_ = true;
-      std::string section;
-      while (!f.eof())
+
+      // The whole file in one read, the lines are parsed as views into it
+      std::string text;
+      f.seekg(0, std::ios::end);
+      text.resize(static_cast<size_t>(f.tellg()));
+      f.seekg(0, std::ios::beg);
+      if (!f.read(&text[0], text.size()))
+        throw std::runtime_error("read profile failure");
+
+      parse(text);
+      TRACE_MESSAGE("profile \"%s\" read", filename_.c_str());
+    }
+  }
+
+
+  void profile::parse(std::string_view text)
+  {
+    std::string_view section;
+    for (size_t number = 1; !text.empty(); number++)
+    {
+      const char* end = static_cast<const char*>(memchr(text.data(), '\n', text.size()));
+      std::string_view line = text.substr(0, end ? end - text.data() : text.size());
+      text.remove_prefix(end ? line.size() + 1 : line.size());
+
+      if (!line.empty() && line.back() == '\r')
+        line.remove_suffix(1); // Saved on Windows
+
+      if (line.empty())
       {
-        std::string line;
-        std::getline(f, line);
+        continue;
+      }
+      else if (line.front() == '[' && line.back() == ']')
+      {
+        section = line.substr(1, line.size() - 2);
+      }
+      else
+      {
+        const char* equal = static_cast<const char*>(memchr(line.data(), '=', line.size()));
+        size_t split = equal ? equal - line.data() : 0;
 
-        if (line.empty())
+        // A key and a value, both non empty, within a section
+        if (split == 0 || split + 1 == line.size() || section.empty())
         {
-          continue;
-        }
-        else if (line[0] == '[' && line[line.length() - 1] == ']')
-        {
-          section = line.substr(1, line.length() - 2);
-        }
-        else
-        {
-          bool valid = false;
-          auto equal = line.find('=');
-          if (equal != std::string::npos)
-          {
-            std::string key = line.substr(0, equal);
-            std::string val = line.substr(equal + 1);
-
-            if (!section.empty())
-            {
-              if (!key.empty() && !val.empty())
-              {
-                data_[section][key] = val;
-                valid = true;
-              }
-            }
-          }
-
-          if (!valid)
-          {
-            throw std::runtime_error("parse profile failure (" + line + ")");
-          }
+          throw std::runtime_error("parse profile failure, line " + std::to_string(number) + " (" + std::string(line) + ")");
         }
+
+        assign(slot(section, line.substr(0, split)), line.substr(split + 1));
       }
-      TRACE_MESSAGE("profile \"%s\" read", filename_.c_str());
     }
   }
 
 
   void profile::save()
   {
-    save_as(filename_);
+    if (filename_.empty())
+      throw std::runtime_error("save profile failure");
+
+    if (persister_ == nullptr)
+    {
+      save_as(filename_);
+      return;
+    }
+
+    exists_ = true;
+    persister_->save(filename_, *this);
   }
 
 
   void profile::save_as(const std::string& path)
   {
-    std::ofstream f(path);
-    if (f.is_open())
+    persister::write(path, serialize(), persister::sync_policy::none);
+    exists_ = true;
+    filename_ = path;
+    TRACE_MESSAGE("profile \"%s\" written", filename_.c_str());
+  }
+
+
+  std::string profile::serialize() const
+  {
+#if defined (_WIN32)
+    const char newline[] = "\r\n"; // As the text mode streams always wrote them
+#else
+    const char newline[] = "\n";
+#endif
+
+    // Written in name order, as the profiles have always been
+    std::vector<std::pair<std::pair<std::string_view, std::string_view>, size_t>> items;
+    for (size_t slot = 0; slot < values_.size(); slot++)
     {
-      exists_ = true;
-      filename_ = path;
-      for (auto& section: data_)
-      {
-        f << "[" << section.first << "]" << std::endl;
-        for (auto& item : section.second)
-        {
-          f << item.first << "=" << item.second << std::endl;
-        }
-      }
-      TRACE_MESSAGE("profile \"%s\" written", filename_.c_str());
+      if (values_[slot].kind != value::kinds::unset)
+        items.push_back({ names::instance().name(slot), slot });
     }
-    else
+    std::sort(items.begin(), items.end());
+
+    std::string out;
+    for (size_t i = 0; i < items.size(); i++)
     {
-      throw std::runtime_error("save profile failure");
+      auto& item = items[i];
+      if (i == 0 || item.first.first != items[i - 1].first.first)
+        out.append("[").append(item.first.first).append("]").append(newline);
+
+      out.append(item.first.second).append("=").append(text(values_[item.second])).append(newline);
     }
+    return out;
+  }
+
+
+  void profile::add(std::string_view section, std::string_view key, const std::string& value)
+  {
+    assign(slot(section, key), value);
+    version_ = next_version();
+  }
+
+
+  void profile::add_integer(std::string_view section, std::string_view key, int64_t integer)
+  {
+    value& v = slot(section, key);
+    v.kind = value::kinds::integer;
+    v.integer = integer;
+    v.text.clear();
+    version_ = next_version();
+  }
+
+
+  void profile::add(const profile_key<int>& key, int64_t integer)
+  {
+    value& v = values_[key.slot];
+    v.kind = value::kinds::integer;
+    v.integer = integer;
+    v.text.clear();
+    version_ = next_version();
+  }
+
+
+  int profile::missing(const profile_key<int>& key)
+  {
+    if (!exists())
+      add(key, key.default_value);
+
+    return key.default_value;
+  }
+
+
+  std::string profile::get(const profile_key<const char*>& key)
+  {
+    const value& v = values_[key.slot];
+    if (v.kind != value::kinds::unset)
+      return text(v);
+
+    if (!exists())
+      add(key.section, key.name, std::string(key.default_value));
+
+    return key.default_value;
+  }
+
+
+  std::string profile::get(const profile_key<const char*>& key) const
+  {
+    const value& v = values_[key.slot];
+    return v.kind != value::kinds::unset ? text(v) : std::string(key.default_value);
+  }
+
+
+  profile::value& profile::slot(std::string_view section, std::string_view key)
+  {
+    size_t slot = names::instance().add(section, key);
+    if (slot >= values_.size())
+      values_.resize(slot + 1, { value::kinds::unset, 0, std::string() });
+
+    return values_[slot];
   }
 
 
-  void profile::add(const std::string& section, const std::string& key, const std::string& value)
+  const profile::value* profile::lookup(std::string_view section, std::string_view key) const
   {
-    data_[section][key] = value;
+    size_t slot = names::instance().find(section, key);
+    if (slot < values_.size() && values_[slot].kind != value::kinds::unset)
+      return &values_[slot];
+
+    return nullptr;
   }
 
 
-  std::string profile::find(const std::string& section, const std::string& key, const std::string& default_value)
+  void profile::assign(value& v, std::string_view text)
   {
-    auto sec = data_.find(section);
-    if (sec != data_.end())
+    // Parsed the way istringstream >> read it, a leading number or 0
+    size_t start = text.find_first_not_of(" \t");
+    start = start == std::string_view::npos ? text.size() : start;
+    size_t skip = start < text.size() && text[start] == '+' ? 1 : 0;
+    auto result = std::from_chars(text.data() + start + skip, text.data() + text.size(), v.integer);
+    if (result.ec != std::errc())
+      v.integer = 0;
+
+    // Only values that print back exactly are stored as integers, so saves are unchanged
+    char buffer[24];
+    auto printed = std::to_chars(std::begin(buffer), std::end(buffer), v.integer);
+    if (result.ec == std::errc() && std::string_view(buffer, printed.ptr - buffer) == text)
     {
-      auto find = sec->second.find(key);
-      if (find != sec->second.end())
-        return find->second;
+      v.kind = value::kinds::integer;
+      v.text.clear();
     }
+    else
+    {
+      v.kind = value::kinds::text;
+      v.text = text;
+    }
+  }
+
+
+  std::string profile::text(const value& v)
+  {
+    if (v.kind != value::kinds::integer)
+      return v.text;
+
+    char buffer[24];
+    auto printed = std::to_chars(std::begin(buffer), std::end(buffer), v.integer);
+    return std::string(buffer, printed.ptr - buffer);
+  }
+
+
+  std::string profile::find(std::string_view section, std::string_view key, const std::string& default_value)
+  {
+    if (const value* found = lookup(section, key))
+      return text(*found);
 
     if (!exists())
       add(section, key, default_value);
@@ -110,15 +367,31 @@ namespace core
   }
 
 
-  std::string profile::find(const std::string& section, const std::string& key, const std::string& default_value) const
+  std::string profile::find(std::string_view section, std::string_view key, const std::string& default_value) const
   {
-    auto sec = data_.find(section);
-    if (sec != data_.end())
-    {
-      auto find = sec->second.find(key);
-      if (find != sec->second.end())
-        return find->second;
-    }
+    if (const value* found = lookup(section, key))
+      return text(*found);
+
+    return default_value;
+  }
+
+
+  int64_t profile::find_integer(std::string_view section, std::string_view key, int64_t default_value)
+  {
+    if (const value* found = lookup(section, key))
+      return found->integer;
+
+    if (!exists())
+      add_integer(section, key, default_value);
+
+    return default_value;
+  }
+
+
+  int64_t profile::find_integer(std::string_view section, std::string_view key, int64_t default_value) const
+  {
+    if (const value* found = lookup(section, key))
+      return found->integer;
 
     return default_value;
   }
@@ -126,6 +399,17 @@ namespace core
 
   bool profile::compare(const profile & rhs) const
   {
-    return data_ == rhs.data_;
+    size_t size = std::max(values_.size(), rhs.values_.size());
+    for (size_t slot = 0; slot < size; slot++)
+    {
+      const value* l = slot < values_.size() && values_[slot].kind != value::kinds::unset ? &values_[slot] : nullptr;
+      const value* r = slot < rhs.values_.size() && rhs.values_[slot].kind != value::kinds::unset ? &rhs.values_[slot] : nullptr;
+      if ((l == nullptr) != (r == nullptr))
+        return false;
+
+      if (l && (l->kind != r->kind || l->integer != r->integer || l->text != r->text))
+        return false;
+    }
+    return true;
   }
 }
@@ -1,11 +1,27 @@
 #pragma once
-#include <map>
+#include "profile_keys.h"
+#include <cstdint>
 #include <string>
+#include <string_view>
 #include <sstream>
+#include <type_traits>
+#include <vector>
 
 
 namespace core
 {
+  class persister;
+
+  /**
+   * @brief An .el profile, sections of key/value pairs
+   *
+   * Section and key names are interned once per process, every (section, key)
+   * pair gets a slot number, and each profile keeps its values in an array
+   * indexed by slot. Looking up a key hashes the names as string_views and
+   * loads the value, without building strings or walking trees. The keys in
+   * profile_keys.h have fixed slots, get() and add() with a key handle skip
+   * the name lookup altogether.
+   */
   class profile
   {
   public:
@@ -17,7 +33,7 @@ namespace core
      */
     profile(const std::string& path);
 
-    profile() = default;
+    profile();
     profile(profile&&) = default;
     profile(const profile&) = default;
     profile& operator=(profile&&) = default;
@@ -25,7 +41,9 @@ namespace core
    ~profile() = default;
 
     /**
-     * @brief Saves the profile
+     * @brief Saves the profile, through the persister when one is set
+     *
+     * Throws when the profile was not loaded from, or saved as, a file.
      */
     void save();
 
@@ -36,6 +54,21 @@ namespace core
     */
     void save_as(const std::string& path);
 
+    /**
+     * @brief Hand save() to a background persister instead of writing in the caller
+     *
+     * @param[in] p The persister, it must outlive the profile and its copies, nullptr to write directly
+     */
+    void persist(persister* p)
+    {
+      persister_ = p;
+    }
+
+    /**
+     * @brief The profile as written to its .el file
+     */
+    std::string serialize() const;
+
     /**
      * @brief Add or update a key/value pair
      *
@@ -43,7 +76,7 @@ namespace core
      * @param[in] key The key
      * @param[in] value The new value
      */
-    void add(const std::string& section, const std::string& key, const std::string& value);
+    void add(std::string_view section, std::string_view key, const std::string& value);
 
     /**
      * @brief Add or update a key/value pair
@@ -53,9 +86,12 @@ namespace core
      * @param[in] value The new value
      */
     template<class T>
-    void add(const std::string& section, const std::string& key, const T& value)
+    void add(std::string_view section, std::string_view key, const T& value)
     {
-      add(section, key, std::to_string(value));
+      if constexpr (std::is_integral_v<T>)
+        add_integer(section, key, static_cast<int64_t>(value));
+      else
+        add(section, key, std::to_string(value));
     }
 
     /**
@@ -65,8 +101,8 @@ namespace core
      * @param[in] key The key
      * @param[in] value The default value to return if the key is missing
      */
-    std::string find(const std::string& section, const std::string& key, const std::string& default_value);
-    std::string find(const std::string& section, const std::string& key, const std::string& default_value) const;
+    std::string find(std::string_view section, std::string_view key, const std::string& default_value);
+    std::string find(std::string_view section, std::string_view key, const std::string& default_value) const;
 
     /**
      * @brief Find a key/value pair from within a section
@@ -76,23 +112,65 @@ namespace core
      * @param[in] value The default value to return if the key is missing
      */
     template<class T>
-    T find(const std::string& section, const std::string& key, const T& default_value)
+    T find(std::string_view section, std::string_view key, const T& default_value)
     {
-      std::istringstream ss(find(section, key, std::to_string(default_value)));
-      T t = T();
-      ss >> t;
-      return t;
+      if constexpr (std::is_integral_v<T>)
+      {
+        return static_cast<T>(find_integer(section, key, static_cast<int64_t>(default_value)));
+      }
+      else
+      {
+        std::istringstream ss(find(section, key, std::to_string(default_value)));
+        T t = T();
+        ss >> t;
+        return t;
+      }
     }
 
     template<class T>
-    T find(const std::string& section, const std::string& key, const T& default_value) const
+    T find(std::string_view section, std::string_view key, const T& default_value) const
+    {
+      if constexpr (std::is_integral_v<T>)
+      {
+        return static_cast<T>(find_integer(section, key, static_cast<int64_t>(default_value)));
+      }
+      else
+      {
+        std::istringstream ss(find(section, key, std::to_string(default_value)));
+        T t = T();
+        ss >> t;
+        return t;
+      }
+    }
+
+    /**
+     * @brief Get a value by key handle, a missing key is added with its default to a new profile
+     *
+     * @param[in] key The key handle
+     */
+    int get(const profile_key<int>& key)
     {
-      std::istringstream ss(find(section, key, std::to_string(default_value)));
-      T t = T();
-      ss >> t;
-      return t;
+      const value& v = values_[key.slot];
+      return v.kind != value::kinds::unset ? static_cast<int>(v.integer) : missing(key);
     }
 
+    int get(const profile_key<int>& key) const
+    {
+      const value& v = values_[key.slot];
+      return v.kind != value::kinds::unset ? static_cast<int>(v.integer) : key.default_value;
+    }
+
+    std::string get(const profile_key<const char*>& key);
+    std::string get(const profile_key<const char*>& key) const;
+
+    /**
+     * @brief Add or update a value by key handle
+     *
+     * @param[in] key The key handle
+     * @param[in] value The new value
+     */
+    void add(const profile_key<int>& key, int64_t value);
+
     /**
      * @brief Compare two profiles
      *
@@ -100,6 +178,17 @@ namespace core
      */
     bool compare(const profile& rhs) const;
 
+    /**
+     * @brief Identifies the contents, a new version is taken whenever they change
+     *
+     * Versions are unique across every profile, copies share a version until
+     * either changes, so equal versions always mean equal contents.
+     */
+    uint64_t version() const
+    {
+      return version_;
+    }
+
     /**
      * @brief Returns true if profile exists on disk
      */
@@ -110,43 +199,42 @@ namespace core
 
   private:
 
+    /**
+     * @brief A value slot, unset slots are keys this profile does not have
+     */
+    struct value
+    {
+      enum class kinds : uint8_t
+      {
+        unset,
+        integer,  // Exactly the integer, the text is only made to save it
+        text,     // Anything else, integer holds what a number read of it gives
+      };
+
+      kinds kind;
+      int64_t integer;
+      std::string text;
+    };
+
+    void parse(std::string_view text);
+    value& slot(std::string_view section, std::string_view key);
+    int missing(const profile_key<int>& key);
+    const value* lookup(std::string_view section, std::string_view key) const;
+    void add_integer(std::string_view section, std::string_view key, int64_t value);
+    int64_t find_integer(std::string_view section, std::string_view key, int64_t default_value);
+    int64_t find_integer(std::string_view section, std::string_view key, int64_t default_value) const;
+
+    static void assign(value& v, std::string_view text);
+    static std::string text(const value& v);
+
     bool exists_;
+    uint64_t version_;
     std::string filename_;
-    std::map<std::string, std::map<std::string, std::string>> data_;
+    persister* persister_;
+    std::vector<value> values_;   // Indexed by slot, always covers the slots of profile_keys.h
   };
 }
 
-template<class T, class U>
-inline bool operator==(const std::map<T, U>& lhs, const std::map<T, U>& rhs)
-{
-  if (lhs.size() != rhs.size())
-  {
-    return false;
-  }
-
-  for (auto& item_lhs : lhs)
-  {
-    auto item_rhs = rhs.find(item_lhs.first);
-    if (item_rhs == rhs.end())
-    {
-      return false;
-    }
-
-    if (item_lhs.second != item_rhs->second)
-    {
-      return false;
-    }
-  }
-  return true;
-}
-
-
-template<class T, class U>
-inline bool operator!=(const std::map<T, U>& lhs, const std::map<T, U>& rhs)
-{
-  return !(lhs == rhs);
-}
-
 
 inline bool operator==(const core::profile& lhs, const core::profile& rhs)
 {
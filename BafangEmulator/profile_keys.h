@@ -0,0 +1,120 @@
+/**
+* @file profile_keys.h
+* Compile time handles for every profile key the emulator uses.
+*
+* Each handle carries its section, key and default, and a fixed slot in
+* every profile, so profile::get(keys::basic::assist3_current) is an array
+* load with no name lookup. The block keys are expanded from the packet
+* schemas, keys read from user files that are not listed here still get
+* slots of their own when the profile is loaded.
+*/
+#pragma once
+#include "packet_basic.h"
+#include "packet_pedal.h"
+#include "packet_throttle.h"
+#include <cstddef>
+#include <string_view>
+
+// The general block is built by hand, it has no schema. The versions are
+// ASCII digits packed into an integer: 0x3331 is "31", 0x31313030 is "1100"
+#define PROFILE_GENERAL_KEYS(STRING, INTEGER) \
+  STRING(manufacturer,      "MANUFACTURER", "HZXT") \
+  STRING(model,             "MODEL",        "BBS3") \
+  INTEGER(hardware_version, "HARDWARD",     0x3331) \
+  INTEGER(firmware_version, "FIRMWARD",     0x31313030) \
+  INTEGER(nominal_voltage,  "VOLTS",        4) \
+  INTEGER(limit_control,    "LIMIT",        30)
+
+// The keys behind the basic block's CUSTOM fields
+#define PROFILE_BASIC_CUSTOM_KEYS(KEY) \
+  KEY(wheel_size,          "WD",  10) \
+  KEY(speed_meter_model,   "SMM",  0) \
+  KEY(speed_meter_signals, "SMS",  1)
+
+
+namespace core
+{
+  /**
+   * @brief A profile key known at compile time
+   *
+   * @tparam T int for numbers, const char* for text
+   */
+  template<class T>
+  struct profile_key
+  {
+    size_t slot;
+    std::string_view section;
+    std::string_view name;
+    T default_value;
+  };
+
+  namespace keys
+  {
+#define PROFILE_KEY_SLOT_general(name, ...) general_##name,
+#define PROFILE_KEY_SLOT_basic(name, ...) basic_##name,
+#define PROFILE_KEY_SLOT_pedal(name, ...) pedal_##name,
+#define PROFILE_KEY_SLOT_throttle(name, ...) throttle_##name,
+#define PROFILE_KEY_SKIP(...)
+
+    enum slots : size_t
+    {
+      PROFILE_GENERAL_KEYS(PROFILE_KEY_SLOT_general, PROFILE_KEY_SLOT_general)
+      PACKET_BASIC_SCHEMA(PROFILE_KEY_SLOT_basic, PROFILE_KEY_SKIP)
+      PROFILE_BASIC_CUSTOM_KEYS(PROFILE_KEY_SLOT_basic)
+      PACKET_PEDAL_SCHEMA(PROFILE_KEY_SLOT_pedal, PROFILE_KEY_SKIP)
+      PACKET_THROTTLE_SCHEMA(PROFILE_KEY_SLOT_throttle, PROFILE_KEY_SKIP)
+      count
+    };
+
+#define PROFILE_KEY_GENERAL_STRING(name, key, value) \
+    inline constexpr profile_key<const char*> name = { slots::general_##name, "General", key, value };
+#define PROFILE_KEY_GENERAL_INTEGER(name, key, value) \
+    inline constexpr profile_key<int> name = { slots::general_##name, "General", key, value };
+#define PROFILE_KEY_FIELD(block, name, key, value) \
+    inline constexpr profile_key<int> name = { slots::block##_##name, response_##block::profile_section, key, value };
+#define PROFILE_KEY_BASIC(name, code, key, value, ...) PROFILE_KEY_FIELD(basic, name, key, value)
+#define PROFILE_KEY_BASIC_CUSTOM(name, key, value) PROFILE_KEY_FIELD(basic, name, key, value)
+#define PROFILE_KEY_PEDAL(name, code, key, value, ...) PROFILE_KEY_FIELD(pedal, name, key, value)
+#define PROFILE_KEY_THROTTLE(name, code, key, value, ...) PROFILE_KEY_FIELD(throttle, name, key, value)
+
+    namespace general
+    {
+      PROFILE_GENERAL_KEYS(PROFILE_KEY_GENERAL_STRING, PROFILE_KEY_GENERAL_INTEGER)
+    }
+
+    namespace basic
+    {
+      PACKET_BASIC_SCHEMA(PROFILE_KEY_BASIC, PROFILE_KEY_SKIP)
+      PROFILE_BASIC_CUSTOM_KEYS(PROFILE_KEY_BASIC_CUSTOM)
+    }
+
+    namespace pedal
+    {
+      PACKET_PEDAL_SCHEMA(PROFILE_KEY_PEDAL, PROFILE_KEY_SKIP)
+    }
+
+    namespace throttle
+    {
+      PACKET_THROTTLE_SCHEMA(PROFILE_KEY_THROTTLE, PROFILE_KEY_SKIP)
+    }
+
+#define PROFILE_KEY_NAME(section, key) { section, key },
+#define PROFILE_KEY_NAME_general(name, key, value) PROFILE_KEY_NAME("General", key)
+#define PROFILE_KEY_NAME_basic(name, code, key, ...) PROFILE_KEY_NAME(response_basic::profile_section, key)
+#define PROFILE_KEY_NAME_basic_custom(name, key, value) PROFILE_KEY_NAME(response_basic::profile_section, key)
+#define PROFILE_KEY_NAME_pedal(name, code, key, ...) PROFILE_KEY_NAME(response_pedal::profile_section, key)
+#define PROFILE_KEY_NAME_throttle(name, code, key, ...) PROFILE_KEY_NAME(response_throttle::profile_section, key)
+
+    /**
+     * @brief The section and key of every slot, in slot order
+     */
+    inline constexpr std::string_view names[slots::count][2] =
+    {
+      PROFILE_GENERAL_KEYS(PROFILE_KEY_NAME_general, PROFILE_KEY_NAME_general)
+      PACKET_BASIC_SCHEMA(PROFILE_KEY_NAME_basic, PROFILE_KEY_SKIP)
+      PROFILE_BASIC_CUSTOM_KEYS(PROFILE_KEY_NAME_basic_custom)
+      PACKET_PEDAL_SCHEMA(PROFILE_KEY_NAME_pedal, PROFILE_KEY_SKIP)
+      PACKET_THROTTLE_SCHEMA(PROFILE_KEY_NAME_throttle, PROFILE_KEY_SKIP)
+    };
+  }
+}
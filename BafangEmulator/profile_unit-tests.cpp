@@ -1,5 +1,6 @@
 #include "gtest/gtest.h"
 #include "profile.h"
+#include <fstream>
 
 
 TEST(profile_test, save)
@@ -32,3 +33,95 @@ TEST(profile_test, add)
   EXPECT_EQ(profile2.find("Throttle Handle", "MODE", 100), 101);
   EXPECT_FALSE(profile1 == profile2);
 }
+
+TEST(profile_test, version)
+{
+  core::profile profile1("DefaultProfile.el");
+  core::profile profile2 = profile1;
+
+  EXPECT_EQ(profile1.version(), profile2.version());
+
+  profile2.add("Basic", "LC", 18);
+  EXPECT_NE(profile1.version(), profile2.version());
+
+  profile1 = profile2;
+  EXPECT_EQ(profile1.version(), profile2.version());
+}
+
+TEST(profile_test, save_order)
+{
+  // Saved in name order whatever order the keys were added in
+  core::profile profile1;
+  profile1.add("Pedal Assist", "SL", 5);
+  profile1.add("Basic", "LC", 18);
+  profile1.add("Basic", "ALC0", 10);
+  profile1.save_as("test.el");
+
+  std::ifstream f("test.el");
+  std::stringstream text;
+  text << f.rdbuf();
+  EXPECT_EQ(text.str(), "[Basic]\nALC0=10\nLC=18\n[Pedal Assist]\nSL=5\n");
+
+  std::string_view section = "Basic";
+  EXPECT_EQ(profile1.find(section, std::string_view("LC"), 0), 18);
+}
+
+TEST(profile_test, typed_values)
+{
+  core::profile profile1;
+  profile1.add("General", "VOLTS", 48);
+  profile1.add("General", "PAD", std::string("007"));
+  profile1.add("General", "MODEL", std::string("BBS3"));
+
+  EXPECT_EQ(profile1.find("General", "VOLTS", 0), 48);
+  EXPECT_EQ(profile1.find("General", "VOLTS", std::string()), "48");
+
+  // Numbers are read from text values, which still save as written
+  EXPECT_EQ(profile1.find("General", "PAD", 0), 7);
+  EXPECT_EQ(profile1.find("General", "PAD", std::string()), "007");
+  EXPECT_EQ(profile1.find("General", "MODEL", 1), 0);
+}
+
+TEST(profile_test, key_handles)
+{
+  core::profile profile1("DefaultProfile.el");
+
+  EXPECT_EQ(profile1.get(core::keys::basic::assist3_current), profile1.find("Basic", "ALC3", 0));
+  EXPECT_EQ(profile1.get(core::keys::throttle::start_volt), profile1.find("Throttle Handle", "SV", 0));
+
+  profile1.add(core::keys::pedal::speed_limit, 25);
+  EXPECT_EQ(profile1.find("Pedal Assist", "SL", 0), 25);
+
+  // Keys without handles still save
+  profile1.add("Basic", "EXTRA", 3);
+  profile1.save_as("test.el");
+  core::profile profile2("test.el");
+  EXPECT_EQ(profile2.find("Basic", "EXTRA", 0), 3);
+  EXPECT_TRUE(profile1 == profile2);
+}
+
+TEST(profile_test, parse)
+{
+  {
+    // Windows line ends and no newline at the end
+    std::ofstream f("test.el", std::ios::binary);
+    f << "[Basic]\r\nLC=18\r\n\r\n[Pedal Assist]\r\nSL=25";
+  }
+  core::profile profile1("test.el");
+  EXPECT_EQ(profile1.find("Basic", "LC", 0), 18);
+  EXPECT_EQ(profile1.find("Pedal Assist", "SL", 0), 25);
+
+  {
+    std::ofstream f("test.el", std::ios::binary);
+    f << "[Basic]\nLC=18\nALC0\n";
+  }
+  try
+  {
+    core::profile profile2("test.el");
+    FAIL();
+  }
+  catch (const std::runtime_error& e)
+  {
+    EXPECT_EQ(std::string(e.what()), "parse profile failure, line 3 (ALC0)");
+  }
+}
@@ -0,0 +1,959 @@
+#include "reactor.h"
+#include "exceptions.h"
+#include "trace.h"
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+#include <stdexcept>
+#include <system_error>
+
+#if defined (__linux__)
+#include <cerrno>
+#include <cstring>
+#include <linux/io_uring.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#endif
+
+
+namespace core
+{
+#if defined (__linux__)
+  struct reactor::impl
+  {
+    using clock = std::chrono::steady_clock;
+
+    struct watch
+    {
+      serial* port;
+      int handle;
+      core::bind ready, closed;
+      bool removed;
+      clock::time_point deadline; // Earliest timer queued for the port
+      bool reading = true;        // Not paused for a peer that is behind on its replies, or by pause()
+      bool writing = false;       // Waiting for the port to take its unsent tail
+      bool full = false;          // The last write found no room, poll before the next
+      bool socket = false;        // Written with send(), which can be told not to raise SIGPIPE
+      unsigned posted = 0;        // io_uring requests that still point at the watch
+    };
+
+    struct timer
+    {
+      clock::time_point due;
+      int handle;     // The port's paced output, or
+      uint64_t id;    // a scheduled callback when non-zero
+
+      bool operator>(const timer& rhs) const
+      {
+        return due > rhs.due;
+      }
+    };
+
+    // A peer this far behind on its replies is not read until it catches up,
+    // so a client that never reads costs at most this much memory
+    static const size_t backlog = 64 * 1024;
+
+    // Tags for the reactor's own descriptors and requests, never a watch address
+    static const uint64_t wakeup_tag = 0;
+    static const uint64_t cancel_tag = 1;
+    static const uint64_t timer_tag  = 2;
+
+    impl()
+      : wakeup_(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK))
+      , timer_(timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK))
+      , armed_(clock::time_point::max())
+      , scheduled_(0)
+      , running_(false)
+    {
+      if (wakeup_ == -1 || timer_ == -1)
+        throw std::system_error(errno, std::generic_category(), "reactor create failure");
+    }
+
+    virtual ~impl()
+    {
+      ::close(timer_);
+      ::close(wakeup_);
+    }
+
+    void add(serial* s, int handle, core::bind&& ready, core::bind&& closed)
+    {
+      std::unique_ptr<watch> w(new watch{ s, handle, std::move(ready), std::move(closed), false, clock::time_point::max() });
+      if (s)
+        configure(w.get());
+      arm(w.get());
+      watches_[handle] = std::move(w);
+    }
+
+    void remove(serial& s)
+    {
+      auto found = watches_.find(s.native_handle());
+      if (found == watches_.end())
+        return;
+
+      disarm(found->second);
+      watches_.erase(found);
+    }
+
+    void schedule(clock::time_point due, core::bind&& func)
+    {
+      uint64_t id = ++scheduled_;
+      callbacks_[id] = std::move(func);
+      timers_.push({ due, -1, id });
+
+      if (due < armed_)
+        arm_timer(due);
+    }
+
+    void pause(int handle, clock::time_point until)
+    {
+      auto found = watches_.find(handle);
+      if (found == watches_.end() || found->second->port || !found->second->reading)
+        return;
+
+      found->second->reading = false;
+      suspend(found->second.get());
+
+      schedule(until, core::bind([this, handle]()
+      {
+        auto found = watches_.find(handle);
+        if (found == watches_.end() || found->second->reading)
+          return;
+
+        found->second->reading = true;
+        resume(found->second.get());
+      }));
+    }
+
+    virtual void run() = 0;
+
+    void stop()
+    {
+      running_ = false;
+
+      uint64_t one = 1;
+      if (::write(wakeup_, &one, sizeof(one)) < 0 && errno != EAGAIN)
+        throw std::system_error(errno, std::generic_category(), "reactor stop failure");
+    }
+
+  protected:
+
+    virtual void arm(watch* w) = 0;
+    virtual void disarm(std::unique_ptr<watch>& w) = 0;
+
+    virtual void configure(watch* w)
+    {
+      w->port->nonblocking(); // One peer that stops reading must not stall the loop
+    }
+
+    /**
+     * @brief Have a port's unsent tail written once the port will take it,
+     * and its reads paused while the tail is over the backlog
+     */
+    virtual void output(watch* w) = 0;
+
+    /**
+     * @brief Stop and restart watching a descriptor for pause()
+     */
+    virtual void suspend(watch* w) = 0;
+    virtual void resume(watch* w) = 0;
+
+    /**
+     * @brief A closed port's watch, kept until the kernel has finished with it
+     */
+    virtual void release(std::unique_ptr<watch>&) {}
+
+    void drain()
+    {
+      uint64_t value = 0; // stop() was called, drain the wakeup
+      if (::read(wakeup_, &value, sizeof(value)) < 0 && errno != EAGAIN)
+        throw std::system_error(errno, std::generic_category(), "reactor wakeup failure");
+    }
+
+    /**
+     * @brief Queue a timer for a port's paced output, if it has any
+     */
+    void schedule(watch* w)
+    {
+      clock::time_point due = w->port->deadline();
+      if (due >= w->deadline)
+        return;
+
+      w->deadline = due;
+      timers_.push({ due, w->handle, 0 });
+
+      if (due < armed_)
+        arm_timer(due);
+    }
+
+    /**
+     * @brief The timer descriptor fired, transmit whatever is now due
+     */
+    void expire()
+    {
+      uint64_t value = 0;
+      if (::read(timer_, &value, sizeof(value)) < 0 && errno != EAGAIN)
+        throw std::system_error(errno, std::generic_category(), "reactor timer failure");
+
+      armed_ = clock::time_point::max();
+
+      clock::time_point now = clock::now();
+      while (!timers_.empty() && timers_.top().due <= now)
+      {
+        timer t = timers_.top();
+        timers_.pop();
+
+        if (t.id)
+        {
+          auto callback = callbacks_.find(t.id);
+          core::bind func = std::move(callback->second);
+          callbacks_.erase(callback);
+
+          try
+          {
+            func();
+          }
+          catch (...)
+          {
+            exception_handler();
+          }
+          continue;
+        }
+
+        // Skip timers superseded by an earlier one or left by a closed port
+        auto found = watches_.find(t.handle);
+        if (found == watches_.end() || found->second->deadline != t.due)
+          continue;
+
+        watch* w = found->second.get();
+        w->deadline = clock::time_point::max();
+
+        try
+        {
+          w->port->transmit();
+        }
+        catch (...)
+        {
+          exception_handler();
+        }
+
+        if (w->port->is_connected())
+        {
+          schedule(w);
+          output(w);
+        }
+        else
+        {
+          closed(w->handle);
+        }
+      }
+
+      if (!timers_.empty() && timers_.top().due < armed_)
+        arm_timer(timers_.top().due);
+    }
+
+    void arm_timer(clock::time_point due)
+    {
+      // steady_clock is CLOCK_MONOTONIC
+      auto since = std::chrono::duration_cast<std::chrono::nanoseconds>(due.time_since_epoch()).count();
+
+      itimerspec spec = {};
+      spec.it_value.tv_sec  = static_cast<time_t>(since / 1000000000);
+      spec.it_value.tv_nsec = static_cast<long>(since % 1000000000);
+      if (spec.it_value.tv_sec == 0 && spec.it_value.tv_nsec == 0)
+        spec.it_value.tv_nsec = 1; // Zero would disarm
+
+      if (timerfd_settime(timer_, TFD_TIMER_ABSTIME, &spec, nullptr) != 0)
+        throw std::system_error(errno, std::generic_category(), "reactor timer failure");
+
+      armed_ = due;
+    }
+
+    void ready(watch* w)
+    {
+      try
+      {
+        if (w->ready)
+          w->ready();
+      }
+      catch (...)
+      {
+        exception_handler();
+      }
+    }
+
+    void closed(int handle)
+    {
+      auto found = watches_.find(handle);
+      if (found == watches_.end())
+        return;
+
+      // Take ownership first, the callback may destroy the port
+      std::unique_ptr<watch> w = std::move(found->second);
+      watches_.erase(found);
+
+      try
+      {
+        if (w->closed)
+          w->closed();
+      }
+      catch (...)
+      {
+        exception_handler();
+      }
+
+      release(w);
+    }
+
+    int wakeup_, timer_;
+    clock::time_point armed_;
+    std::priority_queue<timer, std::vector<timer>, std::greater<timer>> timers_;
+    std::unordered_map<int, std::unique_ptr<watch>> watches_;
+    std::unordered_map<uint64_t, core::bind> callbacks_;
+    uint64_t scheduled_;
+    std::atomic<bool> running_;
+  };
+
+
+  struct epoll_impl : reactor::impl
+  {
+    epoll_impl()
+      : epoll_(epoll_create1(EPOLL_CLOEXEC))
+    {
+      if (epoll_ == -1)
+        throw std::system_error(errno, std::generic_category(), "reactor create failure");
+
+      epoll_event ev = {};
+      ev.events = EPOLLIN;
+      ev.data.u64 = wakeup_tag;
+      if (epoll_ctl(epoll_, EPOLL_CTL_ADD, wakeup_, &ev) != 0)
+        throw std::system_error(errno, std::generic_category(), "reactor add failure");
+
+      ev.data.u64 = timer_tag;
+      if (epoll_ctl(epoll_, EPOLL_CTL_ADD, timer_, &ev) != 0)
+        throw std::system_error(errno, std::generic_category(), "reactor add failure");
+    }
+
+   ~epoll_impl()
+    {
+      ::close(epoll_);
+    }
+
+    void run() override
+    {
+      epoll_event events[64];
+
+      running_ = true;
+      while (running_ && (!watches_.empty() || !callbacks_.empty()))
+      {
+        int count = epoll_wait(epoll_, events, sizeof(events) / sizeof(events[0]), -1);
+        if (count < 0)
+        {
+          if (errno == EINTR)
+            continue;
+
+          throw std::system_error(errno, std::generic_category(), "reactor wait failure");
+        }
+
+        for (int i = 0; i < count; i++)
+        {
+          if (events[i].data.u64 == wakeup_tag)
+          {
+            drain();
+            continue;
+          }
+          else if (events[i].data.u64 == timer_tag)
+          {
+            expire();
+            continue;
+          }
+
+          watch* w = static_cast<watch*>(events[i].data.ptr);
+
+          if (!w->port)
+          {
+            ready(w);
+            continue;
+          }
+
+          try
+          {
+            if (events[i].events & ~EPOLLOUT) // Readable, or hung up
+              w->port->receive();
+            if ((events[i].events & EPOLLOUT) && w->port->is_connected())
+              w->port->send();
+          }
+          catch (...)
+          {
+            exception_handler();
+          }
+
+          // Closing the descriptor has already dropped it from the epoll set
+          if (w->port->is_connected())
+          {
+            schedule(w);
+            output(w);
+          }
+          else
+          {
+            closed(w->handle);
+          }
+        }
+      }
+      running_ = false;
+    }
+
+  protected:
+
+    void arm(watch* w) override
+    {
+      epoll_event ev = {};
+      ev.events = EPOLLIN;
+      ev.data.ptr = w;
+      if (epoll_ctl(epoll_, EPOLL_CTL_ADD, w->handle, &ev) != 0)
+        throw std::system_error(errno, std::generic_category(), "reactor add failure");
+    }
+
+    void disarm(std::unique_ptr<watch>& w) override
+    {
+      if (epoll_ctl(epoll_, EPOLL_CTL_DEL, w->handle, nullptr) != 0)
+        throw std::system_error(errno, std::generic_category(), "reactor remove failure");
+    }
+
+    void suspend(watch* w) override
+    {
+      epoll_event ev = {};
+      ev.data.ptr = w;
+      if (epoll_ctl(epoll_, EPOLL_CTL_MOD, w->handle, &ev) != 0)
+        throw std::system_error(errno, std::generic_category(), "reactor modify failure");
+    }
+
+    void resume(watch* w) override
+    {
+      epoll_event ev = {};
+      ev.events = EPOLLIN;
+      ev.data.ptr = w;
+      if (epoll_ctl(epoll_, EPOLL_CTL_MOD, w->handle, &ev) != 0)
+        throw std::system_error(errno, std::generic_category(), "reactor modify failure");
+    }
+
+    void output(watch* w) override
+    {
+      // Only ask for EPOLLOUT while there is something to send, it is nearly always set
+      size_t unsent = w->port->pending();
+      bool reading = unsent < backlog;
+      bool writing = unsent > 0;
+      if (reading == w->reading && writing == w->writing)
+        return;
+
+      epoll_event ev = {};
+      ev.events = (reading ? EPOLLIN : 0) | (writing ? EPOLLOUT : 0);
+      ev.data.ptr = w;
+      if (epoll_ctl(epoll_, EPOLL_CTL_MOD, w->handle, &ev) != 0)
+        throw std::system_error(errno, std::generic_category(), "reactor modify failure");
+
+      w->reading = reading;
+      w->writing = writing;
+    }
+
+    int epoll_;
+  };
+
+
+  /**
+   * @brief io_uring event loop
+   *
+   * A read is kept posted on every port, straight into the port's receive
+   * buffer, behind a linked poll: a tty with VMIN=0 answers a read with no
+   * data waiting with 0 at once, which would look like a hangup. All
+   * re-posted reads are submitted and every ready completion reaped by one
+   * io_uring_enter per loop, however many ports are busy. Replies only
+   * queue in the port and are written by the ring too, so the replies to
+   * every port served in one pass go out in the same io_uring_enter as the
+   * re-posted reads. A write that finds the port full is retried behind a
+   * POLLOUT poll. Other descriptors use one-shot poll requests re-armed
+   * after each event.
+   */
+  struct uring_impl : reactor::impl
+  {
+    // Set in the user data of the poll ahead of a port's read or write, and
+    // of the write. Watches are aligned, so neither is ever set in a watch
+    static const uint64_t poll_bit  = 1;
+    static const uint64_t write_bit = 2;
+
+    uring_impl(unsigned entries = 4096)
+      : ring_(-1)
+      , pending_(0)
+      , skip_(0)
+    {
+      io_uring_params params = {};
+      ring_ = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+      if (ring_ < 0)
+        throw std::system_error(errno, std::generic_category(), "io_uring setup failure");
+
+      sq_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+      cq_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+      if (params.features & IORING_FEAT_SINGLE_MMAP)
+        sq_size_ = cq_size_ = (sq_size_ > cq_size_ ? sq_size_ : cq_size_);
+
+      sq_ptr_ = mmap(nullptr, sq_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_, IORING_OFF_SQ_RING);
+      cq_ptr_ = (params.features & IORING_FEAT_SINGLE_MMAP) ? sq_ptr_
+              : mmap(nullptr, cq_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_, IORING_OFF_CQ_RING);
+      sqes_ = static_cast<io_uring_sqe*>(mmap(nullptr, params.sq_entries * sizeof(io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_, IORING_OFF_SQES));
+
+      if (sq_ptr_ == MAP_FAILED || cq_ptr_ == MAP_FAILED || sqes_ == MAP_FAILED)
+      {
+        int error = errno;
+        ::close(ring_);
+        throw std::system_error(error, std::generic_category(), "io_uring map failure");
+      }
+
+      char* sq = static_cast<char*>(sq_ptr_);
+      sq_head_  = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+      sq_tail_  = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+      sq_mask_  = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+      sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+      sq_entries_ = params.sq_entries;
+
+      char* cq = static_cast<char*>(cq_ptr_);
+      cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+      cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+      cq_mask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+      cqes_    = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+      sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+
+      // From 5.17 a poll that succeeds need not post a completion at all
+      if (params.features & IORING_FEAT_CQE_SKIP)
+        skip_ = IOSQE_CQE_SKIP_SUCCESS;
+
+      poll(wakeup_, wakeup_tag);
+      poll(timer_, timer_tag);
+    }
+
+   ~uring_impl()
+    {
+      munmap(sqes_, sqes_size_);
+      if (cq_ptr_ != sq_ptr_)
+        munmap(cq_ptr_, cq_size_);
+      munmap(sq_ptr_, sq_size_);
+      ::close(ring_);
+    }
+
+    void run() override
+    {
+      running_ = true;
+      while (running_ && (!watches_.empty() || !callbacks_.empty()))
+      {
+        enter(1); // Submit everything queued and wait for at least one completion
+
+        unsigned head = *cq_head_;
+        unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+        for (; head != tail; head++)
+        {
+          io_uring_cqe cqe = cqes_[head & cq_mask_];
+          __atomic_store_n(cq_head_, head + 1, __ATOMIC_RELEASE);
+          complete(cqe);
+        }
+      }
+      running_ = false;
+    }
+
+  protected:
+
+    void complete(const io_uring_cqe& cqe)
+    {
+      if (cqe.user_data == cancel_tag)
+      {
+        return;
+      }
+      else if (cqe.user_data == wakeup_tag)
+      {
+        drain();
+        poll(wakeup_, wakeup_tag);
+        return;
+      }
+      else if (cqe.user_data == timer_tag)
+      {
+        expire();
+        poll(timer_, timer_tag);
+        return;
+      }
+
+      // A failed poll fails its read too, the read's completion carries on from there
+      if (cqe.user_data > timer_tag && (cqe.user_data & poll_bit))
+        return;
+
+      watch* w = reinterpret_cast<watch*>(cqe.user_data & ~write_bit);
+      bool write = (cqe.user_data & write_bit) != 0;
+      w->posted--;
+
+      if (w->removed)
+      {
+        if (w->posted == 0)
+          retired_.erase(w); // The cancelled requests have finished with it
+        return;
+      }
+
+      if (!w->port)
+      {
+        // A paused descriptor's poll was cancelled, it is re-armed on resume()
+        if (w->reading)
+          ready(w);
+        if (w->reading && w->posted == 0)
+          arm(w);
+        return;
+      }
+
+      try
+      {
+        if (write)
+        {
+          w->writing = false;
+          w->full = cqe.res == -EAGAIN;
+          w->port->sent(cqe.res);
+        }
+        else
+        {
+          w->reading = false;
+          w->port->received(cqe.res); // -ECANCELED here means the poll failed, the port has gone
+        }
+      }
+      catch (...)
+      {
+        exception_handler();
+      }
+
+      if (w->port->is_connected())
+      {
+        schedule(w);
+        output(w);
+      }
+      else
+      {
+        closed(w->handle);
+      }
+    }
+
+    void arm(watch* w) override
+    {
+      w->posted++;
+      if (!w->port)
+      {
+        poll(w->handle, reinterpret_cast<uint64_t>(w));
+        return;
+      }
+      w->reading = true;
+
+      size_t available = 0;
+      char* buffer = w->port->prepare(available);
+
+      io_uring_sqe* sqe = linked(w, POLLIN, 0);
+      sqe->opcode    = IORING_OP_READ;
+      sqe->fd        = w->handle;
+      sqe->addr      = reinterpret_cast<uint64_t>(buffer);
+      sqe->len       = static_cast<unsigned>(available);
+      sqe->off       = static_cast<uint64_t>(-1); // Current position, required for ttys and sockets
+      sqe->user_data = reinterpret_cast<uint64_t>(w);
+    }
+
+    void disarm(std::unique_ptr<watch>& w) override
+    {
+      release(w);
+    }
+
+    void suspend(watch* w) override
+    {
+      // Paused from its own callback the poll has already completed
+      if (w->posted == 0)
+        return;
+
+      io_uring_sqe* sqe = next();
+      sqe->opcode    = IORING_OP_ASYNC_CANCEL;
+      sqe->fd        = -1;
+      sqe->addr      = reinterpret_cast<uint64_t>(w);
+      sqe->user_data = cancel_tag;
+    }
+
+    void resume(watch* w) override
+    {
+      if (w->posted == 0)
+        arm(w);
+    }
+
+    void configure(watch* w) override
+    {
+      w->port->nonblocking();
+      w->port->defer();
+
+      struct stat st;
+      w->socket = fstat(w->handle, &st) == 0 && S_ISSOCK(st.st_mode);
+    }
+
+    void output(watch* w) override
+    {
+      size_t unsent = w->port->pending();
+      if (!w->reading && unsent < backlog)
+        arm(w);
+
+      if (w->writing || unsent == 0)
+        return;
+
+      std::string_view data = w->port->outgoing();
+
+      // A port nearly always has room, so the write goes first and is done
+      // inside the submit. Only once it comes back full does it wait on a poll
+      io_uring_sqe* sqe = w->full ? linked(w, POLLOUT, write_bit) : next();
+      sqe->opcode    = w->socket ? IORING_OP_SEND : IORING_OP_WRITE;
+      sqe->fd        = w->handle;
+      sqe->addr      = reinterpret_cast<uint64_t>(data.data());
+      sqe->len       = static_cast<unsigned>(data.size());
+      sqe->off       = static_cast<uint64_t>(-1);
+      sqe->msg_flags = w->socket ? MSG_NOSIGNAL : 0;
+      sqe->user_data = reinterpret_cast<uint64_t>(w) | write_bit;
+
+      w->writing = true;
+      w->posted++;
+    }
+
+    void release(std::unique_ptr<watch>& w) override
+    {
+      if (w->posted == 0)
+        return;
+
+      // Cancel the polls, which fail the read and write linked to them, and
+      // the read and write in case their polls have already fired. They
+      // still point at the watch, keep it until they have all completed
+      for (uint64_t bit : { poll_bit, uint64_t(0), write_bit | poll_bit, write_bit })
+      {
+        io_uring_sqe* sqe = next();
+        sqe->opcode    = IORING_OP_ASYNC_CANCEL;
+        sqe->fd        = -1;
+        sqe->addr      = reinterpret_cast<uint64_t>(w.get()) | bit;
+        sqe->user_data = cancel_tag;
+      }
+
+      w->removed = true;
+      watch* key = w.get();
+      retired_[key] = std::move(w);
+    }
+
+    /**
+     * @brief Queue a poll for a port, the request returned runs once it fires
+     */
+    io_uring_sqe* linked(watch* w, unsigned events, uint64_t tag)
+    {
+      // The poll and its request must go in the same submit, or the link is lost
+      if (pending_ + 2 > sq_entries_)
+        enter(0);
+
+      io_uring_sqe* sqe = next();
+      sqe->opcode        = IORING_OP_POLL_ADD;
+      sqe->fd            = w->handle;
+      sqe->poll32_events = events;
+      sqe->flags         = IOSQE_IO_LINK | skip_;
+      sqe->user_data     = reinterpret_cast<uint64_t>(w) | tag | poll_bit;
+      return next();
+    }
+
+    void poll(int handle, uint64_t user_data)
+    {
+      io_uring_sqe* sqe = next();
+      sqe->opcode        = IORING_OP_POLL_ADD;
+      sqe->fd            = handle;
+      sqe->poll32_events = POLLIN;
+      sqe->user_data     = user_data;
+    }
+
+    io_uring_sqe* next()
+    {
+      if (pending_ == sq_entries_)
+        enter(0); // Queue full, submit without waiting
+
+      unsigned tail = *sq_tail_;
+      unsigned index = tail & sq_mask_;
+
+      io_uring_sqe* sqe = &sqes_[index];
+      memset(sqe, 0, sizeof(*sqe));
+      sq_array_[index] = index;
+
+      __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+      pending_++;
+      return sqe;
+    }
+
+    void enter(unsigned wait)
+    {
+      unsigned flags = wait ? IORING_ENTER_GETEVENTS : 0;
+      for (;;)
+      {
+        long submitted = syscall(__NR_io_uring_enter, ring_, pending_, wait, flags, nullptr, 0);
+        if (submitted >= 0)
+        {
+          pending_ -= static_cast<unsigned>(submitted);
+          return;
+        }
+
+        if (errno != EINTR && errno != EAGAIN && errno != EBUSY)
+          throw std::system_error(errno, std::generic_category(), "io_uring enter failure");
+      }
+    }
+
+    int ring_;
+    unsigned pending_;
+    unsigned skip_;
+    void* sq_ptr_;
+    void* cq_ptr_;
+    size_t sq_size_, cq_size_, sqes_size_;
+    unsigned* sq_head_;
+    unsigned* sq_tail_;
+    unsigned* sq_array_;
+    unsigned sq_mask_, sq_entries_;
+    unsigned* cq_head_;
+    unsigned* cq_tail_;
+    unsigned cq_mask_;
+    io_uring_sqe* sqes_;
+    io_uring_cqe* cqes_;
+    std::unordered_map<watch*, std::unique_ptr<watch>> retired_;
+  };
+
+
+  namespace
+  {
+    reactor::impl* create(reactor::backends backend)
+    {
+      if (backend == reactor::backends::io_uring)
+      {
+        try
+        {
+          return new uring_impl;
+        }
+        catch (std::system_error& e)
+        {
+          TRACE_MESSAGE("reactor->io_uring unavailable (%s), using epoll", e.what());
+        }
+      }
+      return new epoll_impl;
+    }
+  }
+#else
+  struct reactor::impl
+  {
+    impl()
+    {
+      throw std::runtime_error("reactor not supported on this platform");
+    }
+
+    void add(serial*, serial::native_handle_type, core::bind&&, core::bind&&) {}
+    void schedule(std::chrono::steady_clock::time_point, core::bind&&) {}
+    void pause(serial::native_handle_type, std::chrono::steady_clock::time_point) {}
+    void remove(serial&) {}
+    void run() {}
+    void stop() {}
+  };
+
+
+  namespace
+  {
+    reactor::impl* create(reactor::backends)
+    {
+      return new reactor::impl;
+    }
+  }
+#endif
+
+
+  reactor::reactor(backends backend /*= backends::epoll*/)
+    : impl_(create(backend))
+  {}
+
+
+  reactor::reactor(reactor&&) = default;
+
+
+  reactor& reactor::operator=(reactor&&) = default;
+
+
+  reactor::~reactor()
+  {}
+
+
+  void reactor::add(serial& s)
+  {
+    if (impl_)
+      impl_->add(&s, s.native_handle(), core::bind(), core::bind());
+    else
+      throw std::runtime_error("no state");
+  }
+
+
+  void reactor::add(serial& s, core::bind&& closed)
+  {
+    if (impl_)
+      impl_->add(&s, s.native_handle(), core::bind(), std::move(closed));
+    else
+      throw std::runtime_error("no state");
+  }
+
+
+  void reactor::add(serial::native_handle_type handle, core::bind&& ready)
+  {
+    if (impl_)
+      impl_->add(nullptr, handle, std::move(ready), core::bind());
+    else
+      throw std::runtime_error("no state");
+  }
+
+
+  void reactor::schedule(std::chrono::steady_clock::time_point due, core::bind&& func)
+  {
+    if (impl_)
+      impl_->schedule(due, std::move(func));
+    else
+      throw std::runtime_error("no state");
+  }
+
+
+  void reactor::pause(serial::native_handle_type handle, std::chrono::steady_clock::time_point until)
+  {
+    if (impl_)
+      impl_->pause(handle, until);
+    else
+      throw std::runtime_error("no state");
+  }
+
+
+  void reactor::remove(serial& s)
+  {
+    if (impl_)
+      impl_->remove(s);
+    else
+      throw std::runtime_error("no state");
+  }
+
+
+  void reactor::run()
+  {
+    if (impl_)
+      impl_->run();
+    else
+      throw std::runtime_error("no state");
+  }
+
+
+  void reactor::stop()
+  {
+    if (impl_)
+      impl_->stop();
+    else
+      throw std::runtime_error("no state");
+  }
+}
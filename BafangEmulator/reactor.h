@@ -0,0 +1,105 @@
+#pragma once
+#include "serial.h"
+#include "bind.h"
+#include <chrono>
+#include <memory>
+
+
+namespace core
+{
+  /**
+   * @brief Single threaded event loop servicing many serial ports
+   *
+   * Every attached port is watched by one epoll (or io_uring) instance and
+   * is only read when data arrives, so idle ports cost nothing.
+   */
+  class reactor
+  {
+  public:
+
+    enum class backends
+    {
+      epoll,     // readiness notification, one read syscall per ready port
+      io_uring,  // reads kept posted on every port, reads and writes batched into one submit/reap
+    };
+
+    /**
+     * @brief Constructs the event loop
+     *
+     * @param[in] backend The kernel interface, io_uring falls back to epoll when unavailable
+     */
+    reactor(backends backend = backends::epoll);
+    reactor(reactor&&);
+    reactor(const reactor&) = delete;
+    reactor& operator=(reactor&&);
+    reactor& operator=(const reactor&) = delete;
+   ~reactor();
+
+    /**
+     * @brief Watch a connected port, the port must outlive the reactor
+     *
+     * The port's writes stop blocking, a reply the peer will not take yet
+     * is sent when the port becomes writable, so one stalled peer cannot
+     * hold up the loop.
+     *
+     * @param[in] s The serial port
+     */
+    void add(serial& s);
+
+    /**
+     * @brief Watch a connected port and be told once it has disconnected
+     *
+     * @param[in] s The serial port
+     * @param[in] closed Invoked after the port disconnects, it may destroy the port
+     */
+    void add(serial& s, core::bind&& closed);
+
+    /**
+     * @brief Watch any other descriptor, e.g. a listening socket
+     *
+     * @param[in] handle The descriptor, it must outlive the reactor
+     * @param[in] ready Invoked whenever the descriptor is readable
+     */
+    void add(serial::native_handle_type handle, core::bind&& ready);
+
+    /**
+     * @brief Run a callback once, on the event loop, at a given time
+     *
+     * @param[in] due When to run it
+     * @param[in] func The callback
+     */
+    void schedule(std::chrono::steady_clock::time_point due, core::bind&& func);
+
+    /**
+     * @brief Stop watching a descriptor added with a ready callback for a while,
+     * e.g. a listening socket that cannot accept until descriptors are freed
+     *
+     * @param[in] handle The descriptor
+     * @param[in] until When to watch it again
+     */
+    void pause(serial::native_handle_type handle, std::chrono::steady_clock::time_point until);
+
+    /**
+     * @brief Stop watching a port
+     *
+     * @param[in] s The serial port
+     */
+    void remove(serial& s);
+
+    /**
+     * @brief Dispatch events until nothing is watched or scheduled, or stop() is called
+     */
+    void run();
+
+    /**
+     * @brief Ask run() to return, safe to call from any thread
+     */
+    void stop();
+
+    struct impl;
+
+  private:
+
+    std::unique_ptr<impl> impl_;
+  };
+}
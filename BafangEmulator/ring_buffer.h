@@ -0,0 +1,162 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+
+namespace core
+{
+  /**
+   * @brief Fixed capacity single producer/single consumer byte queue
+   *
+   * The producer (the read syscall) writes straight into prepare() and
+   * publishes with commit(); the consumer sees the bytes through peek()
+   * without them ever being copied. The first Mirror bytes of the storage
+   * are repeated after the end, so a frame of up to Mirror bytes that
+   * wraps around the end is still contiguous when peeked.
+   */
+  template<size_t Capacity, size_t Mirror = 256>
+  class ring_buffer
+  {
+    static_assert((Capacity & (Capacity - 1)) == 0, "capacity must be a power of two");
+    static_assert(Mirror <= Capacity, "mirror must not exceed the capacity");
+
+  public:
+
+    ring_buffer()
+      : head_(0)
+      , tail_(0)
+    {}
+
+    ring_buffer(const ring_buffer&) = delete;
+    ring_buffer& operator=(const ring_buffer&) = delete;
+   ~ring_buffer() = default;
+
+    /**
+     * @brief Producer, retrieve the contiguous free space to write into
+     *
+     * @param[out] available The number of bytes that may be written
+     */
+    char* prepare(size_t& available) noexcept
+    {
+      size_t tail = tail_.load(std::memory_order_relaxed);
+      size_t head = head_.load(std::memory_order_acquire);
+      size_t pos  = tail & (Capacity - 1);
+
+      available = Capacity - (tail - head);
+      if (available > Capacity - pos)
+        available = Capacity - pos;
+
+      return data_ + pos;
+    }
+
+    /**
+     * @brief Producer, publish bytes written into prepare()
+     *
+     * @param[in] size The number of bytes written
+     */
+    void commit(size_t size) noexcept
+    {
+      size_t tail = tail_.load(std::memory_order_relaxed);
+      size_t pos  = tail & (Capacity - 1);
+
+      if (pos < Mirror)
+        memcpy(data_ + Capacity + pos, data_ + pos, (pos + size < Mirror ? size : Mirror - pos));
+
+      tail_.store(tail + size, std::memory_order_release);
+    }
+
+    /**
+     * @brief Consumer, view the buffered bytes without copying
+     *
+     * When the data wraps only the first Capacity - position + Mirror
+     * bytes are visible, which is always enough for a complete frame.
+     */
+    std::string_view peek() const noexcept
+    {
+      size_t head = head_.load(std::memory_order_relaxed);
+      size_t tail = tail_.load(std::memory_order_acquire);
+      size_t pos  = head & (Capacity - 1);
+
+      size_t length = tail - head;
+      if (length > Capacity - pos + Mirror)
+        length = Capacity - pos + Mirror;
+
+      return std::string_view(data_ + pos, length);
+    }
+
+    /**
+     * @brief Consumer, discard bytes from the front
+     *
+     * @param[in] size The number of bytes to discard
+     */
+    void flush(size_t size) noexcept
+    {
+      size_t head = head_.load(std::memory_order_relaxed);
+      size_t tail = tail_.load(std::memory_order_acquire);
+
+      if (size > tail - head)
+        size = tail - head;
+
+      head_.store(head + size, std::memory_order_release);
+    }
+
+    /**
+     * @brief Consumer, discard every buffered byte
+     */
+    void flush_all() noexcept
+    {
+      head_.store(tail_.load(std::memory_order_acquire), std::memory_order_release);
+    }
+
+    /**
+     * @brief Consumer, remove bytes from the front into an owned string
+     *
+     * @param[in] size The number of bytes to remove
+     */
+    std::string read(size_t size)
+    {
+      size_t head = head_.load(std::memory_order_relaxed);
+      size_t tail = tail_.load(std::memory_order_acquire);
+      size_t pos  = head & (Capacity - 1);
+
+      if (size > tail - head)
+        size = tail - head;
+
+      std::string temp;
+      if (pos + size <= Capacity)
+      {
+        temp.assign(data_ + pos, size);
+      }
+      else
+      {
+        temp.reserve(size);
+        temp.assign(data_ + pos, Capacity - pos);
+        temp.append(data_, size - (Capacity - pos));
+      }
+
+      head_.store(head + size, std::memory_order_release);
+      return temp;
+    }
+
+    /**
+     * @brief The number of buffered bytes
+     */
+    size_t size() const noexcept
+    {
+      return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+    }
+
+    static constexpr size_t capacity()
+    {
+      return Capacity;
+    }
+
+  private:
+
+    std::atomic<size_t> head_, tail_;
+    char data_[Capacity + Mirror];
+  };
+}
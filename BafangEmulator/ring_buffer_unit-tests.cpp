@@ -0,0 +1,66 @@
+#include "gtest/gtest.h"
+#include "ring_buffer.h"
+
+
+namespace
+{
+  template<class T>
+  void produce(T& ring, const std::string& data)
+  {
+    size_t available = 0;
+    char* ptr = ring.prepare(available);
+    ASSERT_GE(available, data.size());
+    memcpy(ptr, data.data(), data.size());
+    ring.commit(data.size());
+  }
+}
+
+TEST(ring_buffer, peek_read_flush_test)
+{
+  core::ring_buffer<16, 8> ring;
+
+  produce(ring, "abcdef");
+  EXPECT_EQ(ring.size(), 6);
+  EXPECT_EQ(ring.peek(), "abcdef");
+
+  ring.flush(2);
+  EXPECT_EQ(ring.peek(), "cdef");
+  EXPECT_EQ(ring.read(3), "cde");
+  EXPECT_EQ(ring.size(), 1);
+
+  ring.flush_all();
+  EXPECT_EQ(ring.size(), 0);
+  EXPECT_EQ(ring.peek(), "");
+}
+
+TEST(ring_buffer, wrap_is_contiguous_test)
+{
+  core::ring_buffer<16, 8> ring;
+
+  produce(ring, "0123456789AB");
+  ring.flush(12);
+
+  // Free space is split, the producer only sees up to the end
+  size_t available = 0;
+  ring.prepare(available);
+  EXPECT_EQ(available, 4);
+
+  produce(ring, "wxyz");
+  produce(ring, "1234");
+
+  // The mirror keeps the wrapped frame contiguous
+  EXPECT_EQ(ring.peek(), "wxyz1234");
+  EXPECT_EQ(ring.read(8), "wxyz1234");
+}
+
+TEST(ring_buffer, full_test)
+{
+  core::ring_buffer<16, 8> ring;
+
+  produce(ring, "0123456789ABCDEF");
+
+  size_t available = 0;
+  ring.prepare(available);
+  EXPECT_EQ(available, 0);
+  EXPECT_EQ(ring.read(16), "0123456789ABCDEF");
+}
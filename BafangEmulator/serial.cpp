@@ -1,12 +1,34 @@
 #include "serial.h"
-#include <Windows.h>
+#include "ring_buffer.h"
+#include "endpoint.h"
+#include "pacer.h"
+#include <cctype>
+#include <cstdio>
 #include <stdexcept>
 #include <thread>
 #include <system_error>
 
+#if defined (_WIN32)
+#include <Windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <termios.h>
+#include <unistd.h>
+#if defined (__APPLE__)
+#include <util.h>
+#else
+#include <pty.h>
+#endif
+#endif
+
 
 namespace core
 {
+#if defined (_WIN32)
   struct serial::impl
   {
     impl()
@@ -24,15 +46,26 @@ namespace core
       {
         case events::connected:      connected_      = std::move(func); break;
         case events::disconnected:   disconnected_   = std::move(func); break;
-        case events::data_available: data_available_ = std::move(func); break;
+        case events::data_available: data_available_ = data_bind([func = std::move(func)](std::string_view, size_t) mutable { func(); }); break;
       }
     }
 
+    void event(events ev, data_bind&& func)
+    {
+      if (ev != events::data_available)
+        throw std::invalid_argument("event does not carry data");
+
+      data_available_ = std::move(func);
+    }
+
     void connect(const std::string& port)
     {
       if (is_connected())
         CloseHandle(handle_);
 
+      if (endpoint::parse(port).kind != endpoint::kinds::device)
+        throw std::runtime_error("endpoint not supported on this platform");
+
       port_   = port;
       handle_ = CreateFileA(port_.c_str(),
                             GENERIC_READ | GENERIC_WRITE,
@@ -49,6 +82,18 @@ namespace core
         connected_();
     }
 
+    void adopt(HANDLE handle, const std::string& port)
+    {
+      if (is_connected())
+        CloseHandle(handle_);
+
+      port_   = port;
+      handle_ = handle;
+
+      if (connected_)
+        connected_();
+    }
+
     void disconnect()
     {
       if (is_connected())
@@ -56,6 +101,7 @@ namespace core
         HANDLE temp = handle_;
         handle_ = INVALID_HANDLE_VALUE;
         CloseHandle(temp);
+        pacer_.clear();
 
         if (disconnected_)
           disconnected_();
@@ -64,22 +110,78 @@ namespace core
 
 
     void poll()
+    {
+      receive();
+      transmit();
+      std::this_thread::yield();
+    }
+
+    void receive()
     {
       if (is_connected())
       {
-        char buffer[8092] = { 0 };
+        size_t available = 0;
+        char* buffer = prepare(available);
 
         DWORD length = 0;
-        if (ReadFile(handle_, buffer, sizeof(buffer), &length, 0 /*&osReader*/))
-        {
-          buffer_ += std::string(buffer, length);
-          if (data_available_)
-            data_available_();
-        }
+        if (ReadFile(handle_, buffer, (DWORD)available, &length, 0 /*&osReader*/))
+          received(length);
+        else
+          received(-1); // Timeouts still succeed, so the device has gone
       }
-      std::this_thread::yield();
     }
 
+    char* prepare(size_t& available)
+    {
+      // Unparsed data filling the whole buffer can only be garbage
+      char* buffer = buffer_.prepare(available);
+      if (available == 0)
+      {
+        buffer_.flush_all();
+        buffer = buffer_.prepare(available);
+      }
+      return buffer;
+    }
+
+    void received(long result)
+    {
+      if (result >= 0)
+      {
+        size_t available = 0;
+        char* buffer = buffer_.prepare(available);
+
+        buffer_.commit(result);
+        if (data_available_)
+          data_available_(std::string_view(buffer, result), buffer_.size());
+      }
+      else
+      {
+        disconnect();
+      }
+    }
+
+    void nonblocking()
+    {} // Writes are already bounded by the comm timeouts
+
+    size_t pending() const
+    {
+      return 0;
+    }
+
+    void send()
+    {}
+
+    void defer()
+    {} // Writes go straight out
+
+    std::string_view outgoing()
+    {
+      return std::string_view();
+    }
+
+    void sent(long)
+    {}
+
     void param(const std::string& data)
     {
       DCB dcb;
@@ -92,6 +194,8 @@ namespace core
       if (!SetCommState(handle_, &dcb))
         throw std::system_error(GetLastError(), std::system_category(), "set param failure");
 
+      pacer_.param(dcb.BaudRate, 1 + dcb.ByteSize + (dcb.Parity != NOPARITY ? 1 : 0) + (dcb.StopBits == ONESTOPBIT ? 1 : 2));
+
       COMMTIMEOUTS timeouts;
       timeouts.ReadIntervalTimeout = 20;
       timeouts.ReadTotalTimeoutMultiplier = 10;
@@ -104,29 +208,75 @@ namespace core
 
     void flush(size_t size)
     {
-      buffer_.erase(0, size);
+      buffer_.flush(size);
     }
 
     std::string read(size_t size)
     {
-      std::string temp = buffer_.substr(0, size);
-      buffer_ = buffer_.substr(size);
-      return temp;
+      return buffer_.read(size);
     }
 
     void flush_all()
     {
-      buffer_.clear();
+      buffer_.flush_all();
     }
 
     std::string read_all()
     {
-      std::string temp = std::move(buffer_);
-      flush_all();
-      return temp;
+      return buffer_.read(buffer_.size());
     }
 
-    void write(const std::string& data)
+    void write(std::string_view data)
+    {
+      if (pacer_.enabled())
+        pacer_.push(data);
+      else
+        put(data);
+    }
+
+    void transmit()
+    {
+      pacer_.transmit([this](const std::string& data) { put(data); });
+    }
+
+    pacer::clock::time_point deadline() const
+    {
+      return pacer_.deadline();
+    }
+
+    void time_scale(double scale)
+    {
+      pacer_.time_scale(scale);
+    }
+
+    std::string_view peek() const
+    {
+      return buffer_.peek();
+    }
+
+    size_t size() const
+    {
+      return buffer_.size();
+    }
+
+    const std::string& port() const
+    {
+      return port_;
+    }
+
+    bool is_connected() const
+    {
+      return handle_ != INVALID_HANDLE_VALUE;
+    }
+
+    native_handle_type native_handle() const
+    {
+      return handle_;
+    }
+
+  protected:
+
+    void put(std::string_view data)
     {
       DWORD dwWritten = 0;
       if (!WriteFile(handle_, data.data(), (DWORD)data.length(), &dwWritten, nullptr))
@@ -135,9 +285,338 @@ namespace core
       }
     }
 
-    const std::string& peek() const
+    HANDLE handle_;
+    bind connected_, disconnected_;
+    data_bind data_available_;
+    ring_buffer<8192> buffer_;
+    pacer pacer_;
+    std::string port_;
+  };
+#else
+  struct serial::impl
+  {
+    impl()
+      : handle_(-1)
+      , peer_(-1)
+      , socket_(false)
+      , nonblocking_(false)
+      , deferred_(false)
+    {}
+
+   ~impl()
+    {
+      disconnect();
+    }
+
+    void event(events ev, core::bind&& func)
+    {
+      switch (ev)
+      {
+        case events::connected:      connected_      = std::move(func); break;
+        case events::disconnected:   disconnected_   = std::move(func); break;
+        case events::data_available: data_available_ = data_bind([func = std::move(func)](std::string_view, size_t) mutable { func(); }); break;
+      }
+    }
+
+    void event(events ev, data_bind&& func)
+    {
+      if (ev != events::data_available)
+        throw std::invalid_argument("event does not carry data");
+
+      data_available_ = std::move(func);
+    }
+
+    void connect(const std::string& port)
+    {
+      if (is_connected())
+        close();
+
+      endpoint ep = endpoint::parse(port);
+      if (ep.kind == endpoint::kinds::pty)
+      {
+        open_pty();
+      }
+      else if (ep.is_socket())
+      {
+        port_   = port;
+        handle_ = connect_socket(ep);
+      }
+      else
+      {
+        port_   = port;
+        handle_ = ::open(port_.c_str(), O_RDWR | O_NOCTTY | O_CLOEXEC);
+
+        if (!is_connected())
+          throw std::system_error(errno, std::generic_category(), "open port failure");
+      }
+
+      socket_ = is_socket(handle_);
+      if (nonblocking_)
+        set_nonblocking();
+
+      if (connected_)
+        connected_();
+    }
+
+    void adopt(int handle, const std::string& port)
+    {
+      if (is_connected())
+        close();
+
+      port_   = port;
+      handle_ = handle;
+      socket_ = is_socket(handle_);
+      if (nonblocking_)
+        set_nonblocking();
+
+      if (connected_)
+        connected_();
+    }
+
+    void disconnect()
+    {
+      if (is_connected())
+      {
+        close();
+
+        if (disconnected_)
+          disconnected_();
+      }
+    }
+
+
+    void poll()
+    {
+      if (is_connected())
+      {
+        // Wait for data with the same 100ms budget the Windows comm timeouts allow,
+        // or less when paced output falls due sooner
+        int timeout = 100;
+        auto due = pacer_.deadline();
+        if (due != pacer::clock::time_point::max())
+        {
+          auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(due - pacer::clock::now()).count() + 1;
+          if (wait < timeout)
+            timeout = wait > 0 ? static_cast<int>(wait) : 0;
+        }
+
+        pollfd fd = { handle_, POLLIN, 0 };
+        int ready = ::poll(&fd, 1, timeout);
+
+        if (ready > 0)
+          receive();
+        else if (ready < 0 && errno != EINTR)
+          throw std::system_error(errno, std::generic_category(), "comms poll failure");
+
+        if (is_connected())
+          transmit();
+      }
+      std::this_thread::yield();
+    }
+
+    void receive()
+    {
+      if (is_connected())
+      {
+        size_t available = 0;
+        char* buffer = prepare(available);
+
+        ssize_t length = ::read(handle_, buffer, available);
+        received(length < 0 ? -errno : length);
+      }
+    }
+
+    char* prepare(size_t& available)
+    {
+      // Unparsed data filling the whole buffer can only be garbage
+      char* buffer = buffer_.prepare(available);
+      if (available == 0)
+      {
+        buffer_.flush_all();
+        buffer = buffer_.prepare(available);
+      }
+      return buffer;
+    }
+
+    void received(long result)
+    {
+      if (result > 0)
+      {
+        size_t available = 0;
+        char* buffer = buffer_.prepare(available);
+
+        buffer_.commit(result);
+        if (data_available_)
+          data_available_(std::string_view(buffer, result), buffer_.size());
+      }
+      else if (result == 0 || (result != -EAGAIN && result != -EINTR))
+      {
+        disconnect(); // Device removed or peer hung up
+      }
+    }
+
+    void nonblocking()
+    {
+      nonblocking_ = true;
+      if (is_connected())
+        set_nonblocking();
+    }
+
+    size_t pending() const
+    {
+      return sending_.size() + unsent_.size();
+    }
+
+    void send()
+    {
+      size_t written = 0;
+      while (written < unsent_.size())
+      {
+        ssize_t length = put_some(unsent_.data() + written, unsent_.size() - written);
+        if (length < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          if (errno == EAGAIN || errno == EWOULDBLOCK)
+            break;
+
+          disconnect(); // Peer hung up with replies still owed
+          return;
+        }
+        written += length;
+      }
+      unsent_.erase(0, written);
+    }
+
+    void defer()
+    {
+      deferred_ = true;
+    }
+
+    std::string_view outgoing()
+    {
+      // Only called with no write in flight, so the bytes may move
+      if (sending_.empty())
+        sending_.swap(unsent_);
+      else
+        sending_.append(unsent_);
+      unsent_.clear();
+      return sending_;
+    }
+
+    void sent(long result)
+    {
+      if (result > 0)
+        sending_.erase(0, result);
+      else if (result < 0 && result != -EAGAIN && result != -EINTR)
+        disconnect(); // Peer hung up with replies still owed
+    }
+
+    void param(const std::string& data)
+    {
+      // Same format as BuildCommDCB, i.e. "baud,parity,data,stop"
+      unsigned long baud = 0;
+      char parity = 0;
+      int bits = 0, stop = 0;
+      if (sscanf(data.c_str(), "%lu,%c,%d,%d", &baud, &parity, &bits, &stop) != 4)
+        throw std::system_error(EINVAL, std::generic_category(), "set param failure from string");
+
+      pacer_.param(baud, 1 + bits + (tolower(parity) != 'n' ? 1 : 0) + stop);
+
+      // A socket has no line settings to apply
+      if (socket_)
+        return;
+
+      termios tio;
+      if (tcgetattr(handle_, &tio) != 0)
+        throw std::system_error(errno, std::generic_category(), "set param failure");
+
+      cfmakeraw(&tio);
+      tio.c_cflag |= CLOCAL | CREAD;
+      tio.c_cflag &= ~(CSIZE | PARENB | PARODD | CSTOPB | CRTSCTS);
+
+      switch (bits)
+      {
+        case 5: tio.c_cflag |= CS5; break;
+        case 6: tio.c_cflag |= CS6; break;
+        case 7: tio.c_cflag |= CS7; break;
+        case 8: tio.c_cflag |= CS8; break;
+        default: throw std::system_error(EINVAL, std::generic_category(), "set param failure from string");
+      }
+
+      switch (tolower(parity))
+      {
+        case 'n': break;
+        case 'e': tio.c_cflag |= PARENB; break;
+        case 'o': tio.c_cflag |= PARENB | PARODD; break;
+        default: throw std::system_error(EINVAL, std::generic_category(), "set param failure from string");
+      }
+
+      switch (stop)
+      {
+        case 1: break;
+        case 2: tio.c_cflag |= CSTOPB; break;
+        default: throw std::system_error(EINVAL, std::generic_category(), "set param failure from string");
+      }
+
+      speed_t speed = to_speed(baud);
+      if (cfsetispeed(&tio, speed) != 0 || cfsetospeed(&tio, speed) != 0)
+        throw std::system_error(errno, std::generic_category(), "set param failure");
+
+      // Reads are bounded by poll(), so never block inside read()
+      tio.c_cc[VMIN]  = 0;
+      tio.c_cc[VTIME] = 0;
+
+      if (tcsetattr(handle_, TCSANOW, &tio) != 0)
+        throw std::system_error(errno, std::generic_category(), "set param failure");
+    }
+
+    void flush(size_t size)
     {
-      return buffer_;
+      buffer_.flush(size);
+    }
+
+    std::string read(size_t size)
+    {
+      return buffer_.read(size);
+    }
+
+    void flush_all()
+    {
+      buffer_.flush_all();
+    }
+
+    std::string read_all()
+    {
+      return buffer_.read(buffer_.size());
+    }
+
+    void write(std::string_view data)
+    {
+      if (pacer_.enabled())
+        pacer_.push(data);
+      else
+        put(data);
+    }
+
+    void transmit()
+    {
+      pacer_.transmit([this](const std::string& data) { put(data); });
+    }
+
+    pacer::clock::time_point deadline() const
+    {
+      return pacer_.deadline();
+    }
+
+    void time_scale(double scale)
+    {
+      pacer_.time_scale(scale);
+    }
+
+    std::string_view peek() const
+    {
+      return buffer_.peek();
     }
 
     size_t size() const
@@ -152,15 +631,128 @@ namespace core
 
     bool is_connected() const
     {
-      return handle_ != INVALID_HANDLE_VALUE;
+      return handle_ != -1;
+    }
+
+    native_handle_type native_handle() const
+    {
+      return handle_;
     }
 
   protected:
 
-    HANDLE handle_;
-    bind connected_, disconnected_, data_available_;
-    std::string buffer_, port_;
+    void put(std::string_view data)
+    {
+      // Queue behind anything still unsent, so replies stay in order
+      if (deferred_ || !unsent_.empty())
+      {
+        unsent_.append(data);
+        return;
+      }
+
+      while (!data.empty())
+      {
+        ssize_t written = put_some(data.data(), data.length());
+        if (written < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          if (errno == EAGAIN || errno == EWOULDBLOCK)
+          {
+            unsent_.append(data); // Only on a non-blocking port, the event loop sends the rest
+            return;
+          }
+
+          throw std::system_error(errno, std::generic_category(), "comms write failure");
+        }
+
+        data.remove_prefix(written);
+      }
+    }
+
+    ssize_t put_some(const char* data, size_t length)
+    {
+      return socket_ ? ::send(handle_, data, length, MSG_NOSIGNAL)
+                     : ::write(handle_, data, length);
+    }
+
+    void set_nonblocking()
+    {
+      int flags = fcntl(handle_, F_GETFL);
+      if (flags == -1 || fcntl(handle_, F_SETFL, flags | O_NONBLOCK) == -1)
+        throw std::system_error(errno, std::generic_category(), "set non-blocking failure");
+    }
+
+    void open_pty()
+    {
+      // The emulator owns the master side, the client opens the slave path
+      char name[256] = { 0 };
+      if (openpty(&handle_, &peer_, name, nullptr, nullptr) != 0)
+      {
+        handle_ = peer_ = -1;
+        throw std::system_error(errno, std::generic_category(), "open pty failure");
+      }
+
+      // Keep the slave open ourselves so the master never sees a hangup
+      // while no client is attached
+      fcntl(handle_, F_SETFD, FD_CLOEXEC);
+      fcntl(peer_, F_SETFD, FD_CLOEXEC);
+      port_ = name;
+    }
+
+    static bool is_socket(int handle)
+    {
+      struct stat st;
+      return fstat(handle, &st) == 0 && S_ISSOCK(st.st_mode);
+    }
+
+    void close()
+    {
+      int temp = handle_;
+      handle_ = -1;
+      ::close(temp);
+      pacer_.clear();
+      unsent_.clear();
+      sending_.clear();
+
+      if (peer_ != -1)
+      {
+        ::close(peer_);
+        peer_ = -1;
+      }
+    }
+
+    static speed_t to_speed(unsigned long baud)
+    {
+      switch (baud)
+      {
+        case 300:    return B300;
+        case 600:    return B600;
+        case 1200:   return B1200;
+        case 2400:   return B2400;
+        case 4800:   return B4800;
+        case 9600:   return B9600;
+        case 19200:  return B19200;
+        case 38400:  return B38400;
+        case 57600:  return B57600;
+        case 115200: return B115200;
+        default: throw std::system_error(EINVAL, std::generic_category(), "set param failure, unsupported baud rate");
+      }
+    }
+
+    int handle_, peer_;
+    bool socket_;
+    bool nonblocking_;
+    bool deferred_;
+    bind connected_, disconnected_;
+    data_bind data_available_;
+    ring_buffer<8192> buffer_;
+    pacer pacer_;
+    std::string unsent_;
+    std::string sending_;
+    std::string port_;
   };
+#endif
 
 
   serial::serial()
@@ -168,6 +760,12 @@ namespace core
   {}
 
 
+  serial::serial(serial&&) = default;
+
+
+  serial& serial::operator=(serial&&) = default;
+
+
   serial::~serial()
   {}
 
@@ -181,6 +779,15 @@ namespace core
   }
 
 
+  void serial::event(events ev, data_bind&& func)
+  {
+    if (impl_)
+      impl_->event(ev, std::move(func));
+    else
+      throw std::runtime_error("no state");
+  }
+
+
   void serial::connect(const std::string& port)
   {
     if (impl_)
@@ -190,6 +797,15 @@ namespace core
   }
 
 
+  void serial::adopt(native_handle_type handle, const std::string& port)
+  {
+    if (impl_)
+      impl_->adopt(handle, port);
+    else
+      throw std::runtime_error("no state");
+  }
+
+
   void serial::disconnect()
   {
     if (impl_)
@@ -207,6 +823,114 @@ namespace core
   }
 
 
+  void serial::receive()
+  {
+    if (impl_)
+      impl_->receive();
+    else
+      throw std::runtime_error("no state");
+  }
+
+
+  char* serial::prepare(size_t& available)
+  {
+    if (impl_)
+      return impl_->prepare(available);
+    else
+      throw std::runtime_error("no state");
+  }
+
+
+  void serial::received(long result)
+  {
+    if (impl_)
+      impl_->received(result);
+    else
+      throw std::runtime_error("no state");
+  }
+
+
+  void serial::transmit()
+  {
+    if (impl_)
+      impl_->transmit();
+    else
+      throw std::runtime_error("no state");
+  }
+
+
+  std::chrono::steady_clock::time_point serial::deadline() const
+  {
+    if (impl_)
+      return impl_->deadline();
+    else
+      throw std::runtime_error("no state");
+  }
+
+
+  void serial::time_scale(double scale)
+  {
+    if (impl_)
+      impl_->time_scale(scale);
+    else
+      throw std::runtime_error("no state");
+  }
+
+
+  void serial::nonblocking()
+  {
+    if (impl_)
+      impl_->nonblocking();
+    else
+      throw std::runtime_error("no state");
+  }
+
+
+  size_t serial::pending() const
+  {
+    if (impl_)
+      return impl_->pending();
+    else
+      throw std::runtime_error("no state");
+  }
+
+
+  void serial::send()
+  {
+    if (impl_)
+      impl_->send();
+    else
+      throw std::runtime_error("no state");
+  }
+
+
+  void serial::defer()
+  {
+    if (impl_)
+      impl_->defer();
+    else
+      throw std::runtime_error("no state");
+  }
+
+
+  std::string_view serial::outgoing()
+  {
+    if (impl_)
+      return impl_->outgoing();
+    else
+      throw std::runtime_error("no state");
+  }
+
+
+  void serial::sent(long result)
+  {
+    if (impl_)
+      impl_->sent(result);
+    else
+      throw std::runtime_error("no state");
+  }
+
+
   void serial::param(const std::string& data /*= "9600,n,8,1"*/)
   {
     if (impl_)
@@ -252,7 +976,7 @@ namespace core
   }
 
 
-  void serial::write(const std::string& data)
+  void serial::write(std::string_view data)
   {
     if (impl_)
       impl_->write(data);
@@ -261,7 +985,7 @@ namespace core
   }
 
 
-  const std::string& serial::peek() const
+  std::string_view serial::peek() const
   {
     if (impl_)
       return impl_->peek();
@@ -292,4 +1016,13 @@ namespace core
   {
     return impl_ && impl_->is_connected();
   }
+
+
+  serial::native_handle_type serial::native_handle() const
+  {
+    if (impl_)
+      return impl_->native_handle();
+    else
+      throw std::runtime_error("no state");
+  }
 }
@@ -1,7 +1,9 @@
 #pragma once
 #include "bind.h"
+#include <chrono>
 #include <memory>
 #include <string>
+#include <string_view>
 #include <functional>
 
 namespace core
@@ -17,18 +19,51 @@ namespace core
       data_available,
     };
 
+    /**
+     * @brief data_available callback, receives a view of the newly
+     * received bytes and the total number of bytes now buffered
+     */
+    using data_bind = basic_bind<std::string_view, size_t>;
+
+#if defined (_WIN32)
+    using native_handle_type = void*;
+#else
+    using native_handle_type = int;
+#endif
+
     serial();
-    serial(serial&&) = default;
+    serial(serial&&);
     serial(const serial&) = delete;
-    serial& operator=(serial&&) = default;
+    serial& operator=(serial&&);
     serial& operator=(const serial&) = delete;
    ~serial();
 
     void event(events ev, core::bind&& func);
+    void event(events ev, data_bind&& func);
 
     void connect(const std::string& port);
+    void adopt(native_handle_type handle, const std::string& port);
     void disconnect();
     void poll();
+    void receive();
+
+    // For event loops that issue the read themselves: the space to read
+    // into, then the read result (bytes, 0 at end of file or -errno)
+    char* prepare(size_t& available);
+    void received(long result);
+
+    // For event loops: writes never block, what the port will not take yet
+    // is counted by pending() until the loop finds it writable and calls send()
+    void nonblocking();
+    size_t pending() const;
+    void send();
+
+    // For event loops that issue the write themselves: writes only queue,
+    // then the bytes to write (left in place until sent()), then the write
+    // result (bytes or -errno)
+    void defer();
+    std::string_view outgoing();
+    void sent(long result);
 
     void param(const std::string& data = "9600,n,8,1");
 
@@ -38,14 +73,22 @@ namespace core
     void flush_all();
     std::string read_all();
 
-    void write(const std::string& data);
+    void write(std::string_view data);
+
+    // Wire-time simulation: writes are held back until a line at the
+    // param() baud rate, scaled by time_scale(), would have delivered them
+    void time_scale(double scale);
+    void transmit();
+    std::chrono::steady_clock::time_point deadline() const;
 
-    const std::string& peek() const;
+    std::string_view peek() const;
     size_t size() const;
     const std::string& port() const;
 
     bool is_connected() const;
 
+    native_handle_type native_handle() const;
+
   private:
 
     struct impl;
@@ -1,21 +1,45 @@
 #include "serial_handler.h"
-#include "packet.h"
 #include "packet_types.h"
-#include "packet_builder.h"
 #include "exceptions.h"
+#include <array>
 
 
 namespace core
 {
-  serial_handler::serial_handler(const std::string& port, profile& general, profile& config)
-    : general_(general)
+  serial_handler::serial_handler(const std::string& port, profile& general, profile& config, bool open /*= true*/)
+    : dispatcher_(dispatcher::instance())
+    , parser_(dispatcher_)
+    , address_(port)
+    , nak_(false)
+    , status_mask_(false)
+    , general_(general)
     , config_(config)
   {
     s_.event(core::serial::events::connected, core::bind(&serial_handler::on_connected, this));
     s_.event(core::serial::events::disconnected, core::bind(&serial_handler::on_disconnected, this));
-    s_.event(core::serial::events::data_available, core::bind(&serial_handler::on_data_available, this));
+    s_.event(core::serial::events::data_available, core::serial::data_bind(&serial_handler::on_data_available, this));
 
-    s_.connect(port);
+    if (open)
+      reconnect();
+  }
+
+
+  serial_handler::serial_handler(serial&& s, profile& general, profile& config)
+    : s_(std::move(s))
+    , dispatcher_(dispatcher::instance())
+    , parser_(dispatcher_)
+    , address_(s_.port())
+    , nak_(false)
+    , status_mask_(false)
+    , general_(general)
+    , config_(config)
+  {
+    s_.event(core::serial::events::connected, core::bind(&serial_handler::on_connected, this));
+    s_.event(core::serial::events::disconnected, core::bind(&serial_handler::on_disconnected, this));
+    s_.event(core::serial::events::data_available, core::serial::data_bind(&serial_handler::on_data_available, this));
+
+    // Already connected, e.g. a client accepted by a listener
+    on_connected();
     s_.param("1200,n,8,1");
   }
 
@@ -33,213 +57,170 @@ namespace core
   }
 
 
+  void serial_handler::reconnect()
+  {
+    s_.connect(address_);
+    s_.param("1200,n,8,1");
+  }
+
+
+  void serial_handler::attach(reactor& r)
+  {
+    r.add(s_);
+  }
+
+
+  void serial_handler::attach(reactor& r, core::bind&& closed)
+  {
+    r.add(s_, std::move(closed));
+  }
+
+
+  const std::string& serial_handler::port() const
+  {
+    return s_.port();
+  }
+
+
+  bool serial_handler::is_connected() const
+  {
+    return s_.is_connected();
+  }
+
+
+  void serial_handler::time_scale(double scale)
+  {
+    s_.time_scale(scale);
+  }
+
+
+  void serial_handler::nak(bool enable)
+  {
+    nak_ = enable;
+  }
+
+
+  void serial_handler::status_mask(bool enable)
+  {
+    status_mask_ = enable;
+  }
+
+
   void serial_handler::on_connected()
   {
     TRACE_MESSAGE("on_connected->port: %s", s_.port().c_str());
+    parser_.reset();
   }
 
 
   void serial_handler::on_disconnected()
   {
     TRACE_MESSAGE("on_disconnected->port: %s", s_.port().c_str());
+    parser_.reset();
   }
 
 
-  void serial_handler::on_data_available()
+  void serial_handler::on_data_available(std::string_view received, size_t buffered)
   {
-    std::lock_guard<std::mutex> lock(mutex_); // Lock access to profiles
+    TRACE_MESSAGE("on_data_available->");
+    TRACE_BINARY(received.data(), received.length());
 
-    const std::string& data = s_.peek();
+    // Only the new bytes are buffered, the port was flushed or re-opened since
+    // the last read, so a frame the parser was part way through has gone
+    if (buffered == received.length())
+      parser_.reset();
 
-    TRACE_MESSAGE("on_data_available->");
+    // Handle every whole frame buffered, pipelined requests included, a partial frame waits for the rest
+    size_t length = 0;
+    for (;;)
+    {
+      std::string_view data = s_.peek();
+      frame_parser::results result = parser_.parse(data, length);
+      if (result == frame_parser::results::incomplete)
+        break;
+
+      if (result == frame_parser::results::frame)
+        on_frame(data.substr(0, length));
+      else
+        on_garbage(data, length);
+
+      s_.flush(length);
+    }
+  }
+
+
+  void serial_handler::on_frame(std::string_view data)
+  {
+    const dispatcher::entry* entry = dispatcher_.find(static_cast<packet_commands>(data[0]), static_cast<packet_types>(data[1]));
+    if (!entry)
+    {
+      // The parser only yields frames of registered requests, drop it should that ever change
+      TRACE_MESSAGE("on_data_available->unregistered request dropped");
+      TRACE_BINARY(data.data(), data.length());
+
+      if (nak_)
+        send_nak(data[1], nak_codes::unknown_type);
+      return;
+    }
+
+    TRACE_MESSAGE("on_data_available->request received: %s", entry->name);
     TRACE_BINARY(data.data(), data.length());
 
-    if (data.size() >= 2)
+    try
     {
-      try
+      dispatcher::response_buffer response;
+      size_t length = 0;
       {
-        packet_commands command = static_cast<packet_commands>(data[0]);
-        switch (command)
-        {
-          case packet_commands::read:
-          {
-            packet_types type = static_cast<packet_types>(data[1]);
-            switch (type)
-            {
-              case packet_types::general:
-              {
-                // Valid request
-                request_packet<request_general> request;
-                request.deserialize(data);
-                s_.flush_all();
-
-                TRACE_MESSAGE("on_data_available->request received: read general");
-                TRACE_BINARY(request.data(), request.length());
-
-                // Send response
-                response_packet<response_general> response;
-                packet_builder::build(response, general_);
-                s_.write(response.serialize());
-
-                TRACE_MESSAGE("on_data_available->response sent: read general");
-                TRACE_BINARY(response.data(), response.length());
-              }
-              break;
-
-              case packet_types::basic:
-              {
-                // Basic config requested
-                TRACE_MESSAGE("on_data_available->request received: read basic");
-                TRACE_BINARY(data.data(), data.length());
-                
-                s_.flush_all();
-
-                // Send response
-                response_packet<response_basic> response;
-                packet_builder::build(response, config_);
-                s_.write(response.serialize());
-
-                TRACE_MESSAGE("on_data_available->response sent: read basic");
-                TRACE_BINARY(response.data(), response.length());
-              }
-              break;
-
-              case packet_types::pedal:
-              {
-                // Pedal assist config requested
-                TRACE_MESSAGE("on_data_available->request received: read pedal assist");
-                TRACE_BINARY(data.data(), data.length());
-
-                s_.flush_all();
-
-                // Send response
-                response_packet<response_pedal> response;
-                packet_builder::build(response, config_);
-                s_.write(response.serialize());
-
-                TRACE_MESSAGE("on_data_available->response sent: read pedal assist");
-                TRACE_BINARY(response.data(), response.length());
-              }
-              break;
-
-              case packet_types::throttle:
-              {
-                // Throttle handle config requested
-                TRACE_MESSAGE("on_data_available->request received: read throttle handle");
-                TRACE_BINARY(data.data(), data.length());
-
-                s_.flush_all();
-
-                // Send response
-                response_packet<response_throttle> response;
-                packet_builder::build(response, config_);
-                s_.write(response.serialize());
-
-                TRACE_MESSAGE("on_data_available->response sent: read throttle handle");
-                TRACE_BINARY(response.data(), response.length());
-              }
-              break;
-
-              default:
-              {
-                TRACE_MESSAGE("on_data_available->read type not supported: 0x%X", static_cast<int>(type));
-                s_.flush_all();
-
-                // Should we respond back?
-              }
-            };
-          }
-          break;
-
-          case packet_commands::write:
-          {
-            packet_types type = static_cast<packet_types>(data[1]);
-            switch (type)
-            {
-              case packet_types::basic:
-              {
-                // Basic write requested
-                request_packet<request_basic> request;
-                request.deserialize(data);
-                s_.flush_all();
-
-                TRACE_MESSAGE("on_data_available->request received: write basic");
-                TRACE_BINARY(request.data(), request.length());
-
-                // Send response
-                response_status_basic result = packet_builder::parse(request, config_);
-                response_status_packet<response_status_basic> response(packet_types::basic, result);
-                s_.write(response.serialize());
-
-                TRACE_MESSAGE("on_data_available->response status sent: write basic");
-                TRACE_BINARY(response.data(), response.length());
-              }
-              break;
-
-              case packet_types::pedal:
-              {
-                // Pedal assist write requested
-                request_packet<request_pedal> request;
-                request.deserialize(data);
-                s_.flush_all();
-
-                TRACE_MESSAGE("on_data_available->request received: write pedal assist");
-                TRACE_BINARY(request.data(), request.length());
-
-                // Send response
-                response_status_pedal result = packet_builder::parse(request, config_);
-                response_status_packet<response_status_pedal> response(packet_types::pedal, result);
-                s_.write(response.serialize());
-
-                TRACE_MESSAGE("on_data_available->response status sent: write pedal assist");
-                TRACE_BINARY(response.data(), response.length());
-              }
-              break;
-
-              case packet_types::throttle:
-              {
-                // Throttle handle write requested
-                request_packet<request_throttle> request;
-                request.deserialize(data);
-                s_.flush_all();
-
-                TRACE_MESSAGE("on_data_available->request received: write throttle handle");
-                TRACE_BINARY(request.data(), request.length());
-
-                // Send response
-                response_status_throttle result = packet_builder::parse(request, config_);
-                response_status_packet<response_status_throttle> response(packet_types::throttle, result);
-                s_.write(response.serialize());
-
-                TRACE_MESSAGE("on_data_available->response status sent: write throttle handle");
-                TRACE_BINARY(response.data(), response.length());
-              }
-              break;
-
-              default:
-              {
-                TRACE_MESSAGE("on_data_available->rwrite type not supported: 0x%X", static_cast<int>(type));
-                s_.flush_all();
-
-                // Should we respond back?
-              }
-            }
-          }
-          break;
-
-          default:
-          {
-            TRACE_MESSAGE("on_data_available->write not supported (%d)", static_cast<int>(command));
-            s_.flush_all();
-
-            // We should really respond back?!?
-          }
-        }
-      }
-      catch (...)
-      {
-        exception_handler();
+        std::lock_guard<std::mutex> lock(mutex_); // Lock access to profiles
+        length = entry->func(data, response, general_, config_);
       }
+
+      if (status_mask_ && entry->validate)
+        length = entry->validate(data, response, length);
+      s_.write(std::string_view(response.data(), length));
+
+      TRACE_MESSAGE("on_data_available->response sent: %s", entry->name);
+      TRACE_BINARY(response.data(), length);
+    }
+    catch (...)
+    {
+      exception_handler();
+    }
+  }
+
+
+  void serial_handler::on_garbage(std::string_view data, size_t length)
+  {
+    TRACE_MESSAGE("on_data_available->discarded %zu bytes", length);
+
+    if (!nak_)
+      return;
+
+    // Name the offending byte: the command, or the type of a known command
+    switch (parser_.error())
+    {
+      case frame_parser::errors::unknown_command: send_nak(data[0], nak_codes::unknown_command); break;
+      case frame_parser::errors::unknown_type:    send_nak(data[1], nak_codes::unknown_type);    break;
+      case frame_parser::errors::checksum:        send_nak(data[1], nak_codes::checksum);        break;
+      default:                                    break;
+    }
+  }
+
+
+  void serial_handler::send_nak(char offending, nak_codes code)
+  {
+    std::array<char, 2> response = { offending, static_cast<char>(code) };
+
+    try
+    {
+      s_.write(std::string_view(response.data(), response.size()));
+
+      TRACE_MESSAGE("on_data_available->nak sent");
+      TRACE_BINARY(response.data(), response.size());
+    }
+    catch (...)
+    {
+      exception_handler();
     }
   }
 
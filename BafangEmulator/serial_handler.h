@@ -2,7 +2,10 @@
 #pragma once
 #include "trace.h"
 #include "serial.h"
+#include "reactor.h"
 #include "profile.h"
+#include "dispatcher.h"
+#include "frame_parser.h"
 #include <string>
 #include <mutex>
 
@@ -13,20 +16,47 @@ namespace core
   {
   public:
 
-    serial_handler(const std::string& port, profile& general, profile& config);
+    // The port is opened at once, or left for reconnect() when open is false
+    serial_handler(const std::string& port, profile& general, profile& config, bool open = true);
+    serial_handler(serial&& s, profile& general, profile& config);
    ~serial_handler();
 
     void poll();
+    void reconnect();
+    void attach(reactor& r);
+    void attach(reactor& r, core::bind&& closed);
+
+    const std::string& port() const;
+    bool is_connected() const;
+    void time_scale(double scale);
+
+    // Answer unknown commands, unknown types and checksum failures with a NAK
+    // instead of silence, so probing clients need not wait out a timeout
+    void nak(bool enable);
+
+    // Follow the status byte of a write with a little-endian 32 bit mask of
+    // every failing status code, so a tool can fix all fields in one retry.
+    // A full flash write (wrAll) is followed by the basic, pedal and throttle
+    // masks, after its three statuses
+    void status_mask(bool enable);
 
   protected:
 
     void on_connected();
     void on_disconnected();
-    void on_data_available();
+    void on_data_available(std::string_view received, size_t buffered);
+    void on_frame(std::string_view data);
+    void on_garbage(std::string_view data, size_t length);
+    void send_nak(char offending, nak_codes code);
 
   private:
 
     serial s_;
+    const dispatcher& dispatcher_;
+    frame_parser parser_;
+    std::string address_;
+    bool nak_;
+    bool status_mask_;
     profile& general_;
     profile& config_;
     static std::mutex mutex_;
@@ -0,0 +1,129 @@
+#include "supervisor.h"
+#include "exceptions.h"
+#include "trace.h"
+#include <thread>
+
+
+namespace core
+{
+  supervisor::supervisor(serial_handler& handler, std::chrono::milliseconds initial, std::chrono::milliseconds maximum)
+    : handler_(handler)
+    , reactor_(nullptr)
+    , initial_(initial)
+    , maximum_(maximum)
+    , delay_(initial)
+    , stopped_(false)
+    , retries_(0)
+    , reconnects_(0)
+    , latency_(clock::duration::zero())
+  {}
+
+
+  bool supervisor::open()
+  {
+    lost_ = clock::now();
+    delay_ = initial_;
+
+    try
+    {
+      handler_.reconnect();
+      return true;
+    }
+    catch (...)
+    {
+      exception_handler();
+    }
+
+    TRACE_MESSAGE("supervisor->port %s not open, retrying", handler_.port().c_str());
+    return false;
+  }
+
+
+  void supervisor::run()
+  {
+    while (!stopped_)
+    {
+      // Not yet open when open() failed, go straight to the retries
+      if (handler_.is_connected())
+      {
+        handler_.poll(); // Returns once the port has disconnected
+
+        lost_ = clock::now();
+        delay_ = initial_;
+      }
+
+      while (!stopped_)
+      {
+        std::this_thread::sleep_for(delay_);
+        if (retry())
+          break;
+      }
+    }
+  }
+
+
+  void supervisor::attach(reactor& r)
+  {
+    reactor_ = &r;
+
+    if (handler_.is_connected())
+      handler_.attach(r, core::bind(&supervisor::on_closed, this));
+    else
+      r.schedule(clock::now() + delay_, core::bind(&supervisor::on_retry, this));
+  }
+
+
+  void supervisor::stop()
+  {
+    stopped_ = true;
+  }
+
+
+  void supervisor::on_closed()
+  {
+    if (stopped_)
+      return;
+
+    lost_ = clock::now();
+    delay_ = initial_;
+    reactor_->schedule(lost_ + delay_, core::bind(&supervisor::on_retry, this));
+  }
+
+
+  void supervisor::on_retry()
+  {
+    if (stopped_)
+      return;
+
+    if (retry())
+      handler_.attach(*reactor_, core::bind(&supervisor::on_closed, this));
+    else
+      reactor_->schedule(clock::now() + delay_, core::bind(&supervisor::on_retry, this));
+  }
+
+
+  bool supervisor::retry()
+  {
+    try
+    {
+      handler_.reconnect();
+
+      latency_ = clock::now() - lost_;
+      reconnects_++;
+
+      TRACE_MESSAGE("supervisor->port %s re-opened after %lld ms, %lu retries and %lu re-opens in total",
+                    handler_.port().c_str(),
+                    static_cast<long long>(std::chrono::duration_cast<std::chrono::milliseconds>(latency_).count()),
+                    static_cast<unsigned long>(retries_), static_cast<unsigned long>(reconnects_));
+      return true;
+    }
+    catch (...)
+    {
+      exception_handler();
+    }
+
+    retries_++;
+    delay_ = (delay_ * 2 < maximum_) ? delay_ * 2 : maximum_;
+    return false;
+  }
+}
@@ -0,0 +1,103 @@
+#pragma once
+#include "serial_handler.h"
+#include "reactor.h"
+#include <atomic>
+#include <chrono>
+
+
+namespace core
+{
+  /**
+   * @brief Keeps a port's handler alive across disconnects
+   *
+   * When the port disconnects (e.g. a USB adapter is unplugged) the port is
+   * re-opened with exponential backoff and the handler carries on, without
+   * disturbing any other port. A port that cannot be opened at start is
+   * retried the same way. Retry counts and re-open latency are recorded.
+   */
+  class supervisor
+  {
+  public:
+
+    using clock = std::chrono::steady_clock;
+
+    /**
+     * @brief Constructs the supervisor
+     *
+     * @param[in] handler The handler to keep connected, it must outlive the supervisor
+     * @param[in] initial The first retry delay
+     * @param[in] maximum The retry delay is doubled up to this limit
+     */
+    supervisor(serial_handler& handler,
+               std::chrono::milliseconds initial = std::chrono::milliseconds(100),
+               std::chrono::milliseconds maximum = std::chrono::milliseconds(30000));
+
+    supervisor(const supervisor&) = delete;
+    supervisor& operator=(const supervisor&) = delete;
+   ~supervisor() = default;
+
+    /**
+     * @brief Make the first attempt to open the port, a failure is retried by run() or attach()
+     *
+     * @return true if the port is open
+     */
+    bool open();
+
+    /**
+     * @brief Thread mode, poll the port and re-open it whenever it disconnects, until stop()
+     */
+    void run();
+
+    /**
+     * @brief Event loop mode, attach the port and re-open it from the reactor's timers
+     *
+     * @param[in] r The reactor, it must outlive the supervisor
+     */
+    void attach(reactor& r);
+
+    /**
+     * @brief Give up re-opening the port
+     */
+    void stop();
+
+    /**
+     * @brief Number of failed re-open attempts
+     */
+    unsigned long retries() const
+    {
+      return retries_;
+    }
+
+    /**
+     * @brief Number of successful re-opens
+     */
+    unsigned long reconnects() const
+    {
+      return reconnects_;
+    }
+
+    /**
+     * @brief Time from the last disconnect until the port was open again
+     */
+    clock::duration latency() const
+    {
+      return latency_;
+    }
+
+  protected:
+
+    void on_closed();
+    void on_retry();
+    bool retry();
+
+  private:
+
+    serial_handler& handler_;
+    reactor* reactor_;
+    std::chrono::milliseconds initial_, maximum_, delay_;
+    clock::time_point lost_;
+    std::atomic<bool> stopped_;
+    std::atomic<unsigned long> retries_, reconnects_;
+    clock::duration latency_;
+  };
+}
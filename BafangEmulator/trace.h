@@ -8,6 +8,7 @@
 *	thread safety
 */
 #pragma once
+#include <cstddef>
 
 namespace trace
 {
@@ -0,0 +1,124 @@
+#include "trace.h"
+#include "load_generator.h"
+#include "exceptions.h"
+#include "getopt.h"
+
+#include <cerrno>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+
+void usage()
+{
+  printf("Usage: BafangLoadgen -p PORT [-p PORT...] [-m MIX] [-d SECONDS] [-n REQUESTS]\r\n\r\n"
+         "Load generator for the Bafang controller emulator, reporting latency percentiles.\r\n\r\n"
+         "  -p, --port <ARG>     comms port of a controller, COM1..., /dev/pts/N, tcp://HOST:PORT or unix:///PATH\n"
+         "      --port-list <ARG> file listing one port per line, e.g. from BafangEmulator --virtual-list\n"
+         "  -m, --mix <ARG>      operation=weight pairs, default read-general=1,read-basic=1,read-pedal=1,read-throttle=1\n"
+         "                       writes (write-basic, write-pedal, write-throttle) store the profile on every request\n"
+         "                       read-all and write-all transfer every block in one request\n"
+         "  -d, --duration <ARG> seconds to run for, default 10\n"
+         "  -n, --requests <ARG> requests per port, default no limit\n"
+         "  -h, --help           display this help and exit\n"
+         "  -V, --version        output version information and exit\r\n\r\n");
+}
+
+void version()
+{
+  printf("BafangLoadgen 1.0.0\r\n");
+}
+
+int main(int argc, char* argv[])
+{
+  TRACE_INIT(trace::flag_file);
+  TRACE_FILENAME("BafangLoadgen.txt");
+  TRACE_MESSAGE("Application start");
+
+  std::vector<std::string> ports;
+  std::string mix = "read-general=1,read-basic=1,read-pedal=1,read-throttle=1";
+  double duration = 10.0;
+  unsigned long requests = 0;
+  option long_options[] =
+  {
+    { "port",      required_argument, 0, 'p' },
+    { "port-list", required_argument, 0,  2  },
+    { "mix",       required_argument, 0, 'm' },
+    { "duration",  required_argument, 0, 'd' },
+    { "requests",  required_argument, 0, 'n' },
+    { "help",      no_argument,       0, 'h' },
+    { "version",   no_argument,       0, 'V' },
+    { 0, 0, 0, 0 },
+  };
+
+  /* Handle the arguments */
+  int c = 0, option_index = 0;
+  while ((c = getopt_long(argc, argv, "p:m:d:n:hV", long_options, &option_index)) >= 0)
+  {
+    switch (c)
+    {
+    case 'p':  ports.push_back(optarg); break;
+    case  2 :
+    {
+      FILE* list = fopen(optarg, "r");
+      if (!list)
+        TRACE_MESSAGE("port list \"%s\" open failure: %s", optarg, strerror(errno));
+      char line[256];
+      while (list && fgets(line, sizeof(line), list))
+      {
+        std::string port(line);
+        port.erase(port.find_last_not_of("\r\n") + 1);
+        if (!port.empty())
+          ports.push_back(port);
+      }
+      if (list)
+        fclose(list);
+    }
+    break;
+    case 'm':  mix = optarg; break;
+    case 'd':
+    {
+      // Whole seconds or fractions, as long as the milliseconds fit the run
+      char* end = nullptr;
+      duration = strtod(optarg, &end);
+      if (end == optarg || *end != '\0' || !std::isfinite(duration) || duration <= 0.0 || duration * 1000 >= LLONG_MAX)
+      {
+        usage();
+        return 1;
+      }
+    }
+    break;
+    case 'n':  requests = strtoul(optarg, nullptr, 10); break;
+    case 'V':  version();        return 0;
+    case 'h':
+    case '\0':
+    case ':':
+    case '?':  usage();          return 0;
+    }
+  }
+
+  if (!ports.empty())
+  {
+    try
+    {
+      core::load_generator generator(ports, mix);
+      generator.run(std::chrono::milliseconds(static_cast<long long>(duration * 1000)), requests);
+      generator.report(stdout);
+
+      return generator.failures() == 0 ? 0 : 1;
+    }
+    catch (...)
+    {
+      core::exception_handler();
+    }
+  }
+  else
+  {
+    usage();
+  }
+  return 1;
+}
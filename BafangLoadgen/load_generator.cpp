@@ -0,0 +1,315 @@
+#include "load_generator.h"
+#include "serial.h"
+#include "packet.h"
+#include "packet_general.h"
+#include "packet_basic.h"
+#include "packet_pedal.h"
+#include "packet_throttle.h"
+#include "packet_all.h"
+#include "exceptions.h"
+#include "trace.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <stdexcept>
+#include <thread>
+
+
+namespace core
+{
+  namespace
+  {
+    using clock = std::chrono::steady_clock;
+
+    const char* names[] =
+    {
+      "read-general",
+      "read-basic",
+      "read-pedal",
+      "read-throttle",
+      "write-basic",
+      "write-pedal",
+      "write-throttle",
+      "read-all",
+      "write-all",
+    };
+
+    /**
+     * @brief A request and the exact response expected for it
+     */
+    struct exchange
+    {
+      std::string request;
+      std::string response;
+    };
+
+    bool transact(serial& s, const std::string& request, size_t expected, std::string& response)
+    {
+      auto timeout = clock::now() + std::chrono::seconds(1);
+
+      s.flush_all();
+      s.write(request);
+
+      while (s.is_connected() && s.size() < expected && clock::now() < timeout)
+      {
+        s.poll();
+      }
+
+      if (s.size() < expected)
+        return false;
+
+      response = s.read(expected);
+      return true;
+    }
+
+    template<class T>
+    std::string read_request()
+    {
+      // Configuration reads are just the command and type
+      return std::string{ static_cast<char>(packet_commands::read), static_cast<char>(T::packet_type) };
+    }
+
+    template<>
+    std::string read_request<response_general>()
+    {
+      request_packet<request_general> request;
+      request.payload.unknown = 0xB0;
+      request.verification = request.verify();
+      return request.serialize();
+    }
+
+    template<class T>
+    exchange read_exchange(serial& s)
+    {
+      exchange x = { read_request<T>(), std::string() };
+
+      // The first response is the reference every later one must match
+      if (!transact(s, x.request, response_packet<T>::packet_size(), x.response))
+        throw std::runtime_error("no response to the initial read");
+
+      response_packet<T> response;
+      response.deserialize(x.response);
+      if (response.type != T::packet_type || response.size != response_packet<T>::packet_size())
+        throw std::runtime_error("malformed response to the initial read");
+
+      return x;
+    }
+
+    template<class T, class Status>
+    exchange write_exchange(const exchange& read)
+    {
+      // Write back what was read, so the controller's configuration is left untouched
+      response_packet<T> current;
+      current.deserialize(read.response);
+
+      request_packet<T> request(packet_commands::write, T::packet_type);
+      request.payload = current.payload;
+      request.verification = request.verify();
+
+      response_status_packet<Status> response(T::packet_type, Status::success);
+      return { request.serialize(), response.serialize() };
+    }
+
+    exchange read_all_exchange(const std::vector<exchange>& reads)
+    {
+      // The full flash read answers with every single block response back-to-back
+      exchange x = { std::string{ static_cast<char>(packet_commands::read), static_cast<char>(packet_types::all) }, std::string() };
+      for (const auto& read : reads)
+      {
+        x.response += read.response;
+      }
+      return x;
+    }
+
+    exchange write_all_exchange(const exchange& basic, const exchange& pedal, const exchange& throttle)
+    {
+      response_packet<request_basic> current_basic;
+      response_packet<request_pedal> current_pedal;
+      response_packet<request_throttle> current_throttle;
+      current_basic.deserialize(basic.response);
+      current_pedal.deserialize(pedal.response);
+      current_throttle.deserialize(throttle.response);
+
+      request_packet<request_all> request(packet_commands::write, packet_types::all);
+      request.payload.basic = current_basic.payload;
+      request.payload.pedal = current_pedal.payload;
+      request.payload.throttle = current_throttle.payload;
+      request.verification = request.verify();
+
+      std::string response = response_status_packet<response_status_basic>(packet_types::basic, response_status_basic::success).serialize() +
+                             response_status_packet<response_status_pedal>(packet_types::pedal, response_status_pedal::success).serialize() +
+                             response_status_packet<response_status_throttle>(packet_types::throttle, response_status_throttle::success).serialize();
+      return { request.serialize(), response };
+    }
+  }
+
+
+  load_generator::load_generator(const std::vector<std::string>& ports, const std::string& mix)
+    : ports_(ports)
+    , weights_(static_cast<size_t>(operations::count), 0)
+    , elapsed_(clock::duration::zero())
+  {
+    size_t start = 0;
+    while (start < mix.length())
+    {
+      size_t end = mix.find(',', start);
+      if (end == std::string::npos)
+        end = mix.length();
+
+      std::string item = mix.substr(start, end - start);
+      size_t equals = item.find('=');
+      std::string key = item.substr(0, equals);
+      unsigned int weight = (equals == std::string::npos) ? 1 : static_cast<unsigned int>(atoi(item.c_str() + equals + 1));
+
+      size_t i = 0;
+      while (i < weights_.size() && key != names[i])
+      {
+        i++;
+      }
+      if (i == weights_.size())
+        throw std::runtime_error("unknown operation: " + key);
+
+      weights_[i] = weight;
+      start = end + 1;
+    }
+
+    if (std::all_of(weights_.begin(), weights_.end(), [](unsigned int w) { return w == 0; }))
+      throw std::runtime_error("empty operation mix");
+  }
+
+
+  void load_generator::run(std::chrono::milliseconds duration, unsigned long requests)
+  {
+    results_.assign(ports_.size(), results(static_cast<size_t>(operations::count)));
+
+    auto start = clock::now();
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < ports_.size(); i++)
+    {
+      workers.emplace_back(&load_generator::worker, this, std::cref(ports_[i]), start + duration, requests, std::ref(results_[i]));
+    }
+
+    for (auto& w : workers)
+    {
+      w.join();
+    }
+    elapsed_ = clock::now() - start;
+  }
+
+
+  void load_generator::worker(const std::string& port, clock::time_point until, unsigned long requests, results& result) const
+  {
+    try
+    {
+      serial s;
+      s.connect(port);
+      s.param("1200,n,8,1");
+
+      std::vector<exchange> exchanges(static_cast<size_t>(operations::count));
+      exchanges[static_cast<size_t>(operations::read_general)]  = read_exchange<response_general>(s);
+      exchanges[static_cast<size_t>(operations::read_basic)]    = read_exchange<response_basic>(s);
+      exchanges[static_cast<size_t>(operations::read_pedal)]    = read_exchange<response_pedal>(s);
+      exchanges[static_cast<size_t>(operations::read_throttle)] = read_exchange<response_throttle>(s);
+      exchanges[static_cast<size_t>(operations::write_basic)]    = write_exchange<request_basic, response_status_basic>(exchanges[static_cast<size_t>(operations::read_basic)]);
+      exchanges[static_cast<size_t>(operations::write_pedal)]    = write_exchange<request_pedal, response_status_pedal>(exchanges[static_cast<size_t>(operations::read_pedal)]);
+      exchanges[static_cast<size_t>(operations::write_throttle)] = write_exchange<request_throttle, response_status_throttle>(exchanges[static_cast<size_t>(operations::read_throttle)]);
+      exchanges[static_cast<size_t>(operations::read_all)] = read_all_exchange({ exchanges.begin(), exchanges.begin() + static_cast<size_t>(operations::write_basic) });
+      exchanges[static_cast<size_t>(operations::write_all)] = write_all_exchange(exchanges[static_cast<size_t>(operations::read_basic)],
+                                                                                 exchanges[static_cast<size_t>(operations::read_pedal)],
+                                                                                 exchanges[static_cast<size_t>(operations::read_throttle)]);
+
+      // Operations are drawn at random in proportion to their weights
+      std::vector<size_t> schedule;
+      for (size_t i = 0; i < weights_.size(); i++)
+      {
+        schedule.insert(schedule.end(), weights_[i], i);
+      }
+      std::mt19937 random(static_cast<unsigned int>(std::hash<std::string>()(port)));
+      std::uniform_int_distribution<size_t> pick(0, schedule.size() - 1);
+
+      std::string response;
+      for (unsigned long sent = 0; (requests == 0 || sent < requests) && clock::now() < until && s.is_connected(); sent++)
+      {
+        size_t op = schedule[pick(random)];
+        const exchange& x = exchanges[op];
+
+        auto begin = clock::now();
+        bool ok = transact(s, x.request, x.response.length(), response) && response == x.response;
+        auto latency = std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - begin);
+
+        if (ok)
+          result[op].latencies.push_back(static_cast<uint32_t>(latency.count()));
+        else
+          result[op].failures++;
+      }
+    }
+    catch (...)
+    {
+      exception_handler();
+      result[static_cast<size_t>(operations::read_general)].failures++;
+    }
+  }
+
+
+  void load_generator::report(FILE* out) const
+  {
+    auto percentile = [](const std::vector<uint32_t>& sorted, double q) -> uint32_t
+    {
+      if (sorted.empty())
+        return 0;
+
+      size_t rank = static_cast<size_t>(std::ceil(q * sorted.size()));
+      return sorted[std::min(sorted.size(), std::max<size_t>(rank, 1)) - 1];
+    };
+
+    double seconds = std::chrono::duration<double>(elapsed_).count();
+    unsigned long total = 0, failed = 0;
+
+    fprintf(out, "%-16s %10s %9s %10s %10s %10s %10s\n", "operation", "responses", "failures", "per sec", "p50 us", "p99 us", "p999 us");
+    for (size_t op = 0; op < static_cast<size_t>(operations::count); op++)
+    {
+      std::vector<uint32_t> latencies;
+      unsigned long failures = 0;
+      for (const auto& r : results_)
+      {
+        latencies.insert(latencies.end(), r[op].latencies.begin(), r[op].latencies.end());
+        failures += r[op].failures;
+      }
+
+      if (latencies.empty() && failures == 0)
+        continue;
+
+      std::sort(latencies.begin(), latencies.end());
+      fprintf(out, "%-16s %10zu %9lu %10.0f %10u %10u %10u\n", names[op], latencies.size(), failures,
+              seconds > 0 ? latencies.size() / seconds : 0.0,
+              percentile(latencies, 0.50), percentile(latencies, 0.99), percentile(latencies, 0.999));
+
+      total += static_cast<unsigned long>(latencies.size());
+      failed += failures;
+    }
+
+    fprintf(out, "%lu responses, %lu failures across %zu ports in %.2f s, %.0f per sec\n",
+            total, failed, ports_.size(), seconds, seconds > 0 ? total / seconds : 0.0);
+  }
+
+
+  unsigned long load_generator::failures() const
+  {
+    unsigned long failed = 0;
+    for (const auto& r : results_)
+    {
+      for (const auto& op : r)
+      {
+        failed += op.failures;
+      }
+    }
+    return failed;
+  }
+
+
+  const char* load_generator::name(operations op)
+  {
+    return names[static_cast<size_t>(op)];
+  }
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+
+namespace core
+{
+  /**
+   * @brief Drives emulated controllers with a mix of requests and measures
+   * the request/response round trip of every packet type
+   */
+  class load_generator
+  {
+  public:
+
+    enum class operations
+    {
+      read_general,
+      read_basic,
+      read_pedal,
+      read_throttle,
+      write_basic,
+      write_pedal,
+      write_throttle,
+      read_all,
+      write_all,
+      count,
+    };
+
+    /**
+     * @brief Constructs the load generator
+     *
+     * @param[in] ports The ports to drive, one worker thread each
+     * @param[in] mix Comma separated operation=weight pairs, e.g. "read-general=4,write-basic=1,read-all=1"
+     */
+    load_generator(const std::vector<std::string>& ports, const std::string& mix);
+   ~load_generator() = default;
+
+    /**
+     * @brief Issue requests until the duration has passed or every worker has sent its requests
+     *
+     * @param[in] duration The time limit
+     * @param[in] requests The number of requests per port, 0 for no limit
+     */
+    void run(std::chrono::milliseconds duration, unsigned long requests);
+
+    /**
+     * @brief Print throughput and p50/p99/p999 latency per operation
+     *
+     * @param[in] out The stream to print to
+     */
+    void report(FILE* out) const;
+
+    /**
+     * @brief Number of failed or mismatched responses
+     */
+    unsigned long failures() const;
+
+    static const char* name(operations op);
+
+  protected:
+
+    struct statistics
+    {
+      std::vector<uint32_t> latencies; // microseconds
+      unsigned long failures = 0;
+    };
+
+    using results = std::vector<statistics>;
+
+    void worker(const std::string& port, std::chrono::steady_clock::time_point until, unsigned long requests, results& result) const;
+
+  private:
+
+    std::vector<std::string> ports_;
+    std::vector<unsigned int> weights_;
+    std::vector<results> results_;
+    std::chrono::steady_clock::duration elapsed_;
+  };
+}